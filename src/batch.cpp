@@ -0,0 +1,407 @@
+/**
+BSD-3-Clause
+Copyright 2019 Alliance for Sustainable Energy, LLC
+Redistribution and use in source and binary forms, with or without modification, are permitted provided
+that the following conditions are met :
+1.	Redistributions of source code must retain the above copyright notice, this list of conditions
+and the following disclaimer.
+2.	Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+and the following disclaimer in the documentation and/or other materials provided with the distribution.
+3.	Neither the name of the copyright holder nor the names of its contributors may be used to endorse
+or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER, CONTRIBUTORS, UNITED STATES GOVERNMENT OR UNITED STATES
+DEPARTMENT OF ENERGY, NOR ANY OF THEIR EMPLOYEES, BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+OR CONSEQUENTIAL DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Headless batch runner: loads a .sam project and runs its cases, their
+// parametric tables, or P50/P90 weather folders on all available cores
+// without any user interface, writing results to a folder.
+
+#include <vector>
+
+#include <wx/app.h>
+#include <wx/cmdline.h>
+#include <wx/dir.h>
+#include <wx/ffile.h>
+#include <wx/filename.h>
+#include <wx/log.h>
+#include <wx/thread.h>
+#include <wx/wfstream.h>
+
+#include "main.h"
+#include "case.h"
+#include "project.h"
+#include "parametric.h"
+#include "simulation.h"
+#include "simtrace.h"
+
+static const wxCmdLineEntryDesc g_cmdLineDesc[] =
+{
+	{ wxCMD_LINE_SWITCH, "h", "help", "show this help message", wxCMD_LINE_VAL_NONE, wxCMD_LINE_OPTION_HELP },
+	{ wxCMD_LINE_OPTION, "c", "cases", "comma separated names of the cases to run (default: all cases)", wxCMD_LINE_VAL_STRING },
+	{ wxCMD_LINE_OPTION, "t", "threads", "number of simulation threads (default: number of cores)", wxCMD_LINE_VAL_NUMBER },
+	{ wxCMD_LINE_SWITCH, "p", "parametric", "run the parametric table of each case" },
+	{ wxCMD_LINE_OPTION, "w", "p50p90", "run each case once per weather file in this folder", wxCMD_LINE_VAL_STRING },
+	{ wxCMD_LINE_OPTION, "o", "output", "folder for the results (default: <project>_results next to the project file)", wxCMD_LINE_VAL_STRING },
+	{ wxCMD_LINE_OPTION, "s", "select", "comma separated names of the outputs to keep (default: all single value outputs)", wxCMD_LINE_VAL_STRING },
+	{ wxCMD_LINE_SWITCH, "a", "all-outputs", "also write every output of each run to a binary file" },
+	{ wxCMD_LINE_OPTION, "r", "trace", "write the time spent in each simulation stage to a Chrome/Perfetto trace file", wxCMD_LINE_VAL_STRING },
+	{ wxCMD_LINE_SWITCH, "v", "verbose", "show log and simulation messages" },
+	{ wxCMD_LINE_PARAM, NULL, NULL, "project file", wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_MANDATORY },
+	{ wxCMD_LINE_NONE }
+};
+
+// reports overall progress a few times a minute, which is
+// readable in the log of an unattended run
+class ConsoleMonitor : public ISimulationMonitor
+{
+	std::vector<float> m_percent;
+	bool m_verbose;
+	long m_lastReport;
+	wxStopWatch m_sw;
+public:
+	ConsoleMonitor( int nthreads, bool verbose )
+		: m_percent( nthreads > 0 ? nthreads : 1, 0.0f ), m_verbose( verbose ), m_lastReport( 0 ) { }
+
+	virtual void Update( int thread, float percent, const wxString & )
+	{
+		if ( thread < 0 || thread >= (int)m_percent.size() ) return;
+		m_percent[thread] = percent;
+
+		long now = m_sw.Time();
+		if ( now - m_lastReport < 5000 ) return;
+		m_lastReport = now;
+
+		float total = 0.0f;
+		for( size_t i=0;i<m_percent.size();i++ )
+			total += m_percent[i];
+		wxPrintf( "%.1f%% complete after %.1f s\n", total / m_percent.size(), 0.001*now );
+		fflush( stdout );
+	}
+
+	virtual void Log( const wxArrayString &messages )
+	{
+		if ( !m_verbose ) return;
+		for( size_t i=0;i<messages.size();i++ )
+			wxFprintf( stderr, "%s\n", messages[i] );
+	}
+
+	virtual bool IsCanceled() { return false; }
+};
+
+struct BatchJob
+{
+	wxString file; // results file name without extension
+	std::vector<Simulation*> sims;
+	wxArrayString outputs;
+};
+
+static wxString SafeFileName( const wxString &name )
+{
+	wxString safe;
+	for( size_t i=0;i<name.Len();i++ )
+	{
+		wxUniChar c = name[i];
+		safe += ( wxIsalnum( c.GetValue() ) || c == '-' || c == '_' ) ? c : wxUniChar('_');
+	}
+	return safe;
+}
+
+static wxString CsvText( const wxString &s )
+{
+	wxString q( s );
+	q.Replace( "\"", "\"\"" );
+	return "\"" + q + "\"";
+}
+
+static void ListWeatherFiles( const wxString &folder, wxArrayString &files, std::vector<int> &years )
+{
+	// same naming convention as the P50/P90 form: the year is the
+	// four digits immediately before the extension
+	wxArrayString list;
+	wxDir::GetAllFiles( folder, &list, wxEmptyString, wxDIR_FILES );
+	list.Sort();
+	for( size_t i=0;i<list.size();i++ )
+	{
+		wxFileName fn( list[i] );
+		wxString ext = fn.GetExt().Lower();
+		if ( ext != "tm2" && ext != "tm3" && ext != "csv" && ext != "smw" && ext != "srw" )
+			continue;
+
+		wxString name = fn.GetName();
+		long yrval = -1;
+		if ( name.Len() >= 4 && name.Right( 4 ).ToLong( &yrval ) && yrval > 1900 )
+		{
+			files.Add( list[i] );
+			years.push_back( (int)yrval );
+		}
+	}
+}
+
+static bool WriteResults( const wxString &folder, BatchJob &job, bool all_outputs )
+{
+	wxArrayString names( job.outputs );
+	if ( names.size() == 0 )
+	{
+		// no selection: every single value output of the first successful run
+		for( size_t i=0;i<job.sims.size() && names.size() == 0;i++ )
+		{
+			if ( !job.sims[i]->Ok() ) continue;
+			wxArrayString list = job.sims[i]->ListOutputs();
+			for( size_t j=0;j<list.size();j++ )
+				if ( VarValue *vv = job.sims[i]->GetOutput( list[j] ) )
+					if ( vv->Type() == VV_NUMBER )
+						names.Add( list[j] );
+		}
+		names.Sort();
+	}
+
+	wxFFile csv( folder + "/" + job.file + ".csv", "w" );
+	if ( !csv.IsOpened() ) return false;
+
+	csv.Write( "run,ok,time_ms" );
+	for( size_t j=0;j<names.size();j++ )
+		csv.Write( "," + CsvText( names[j] ) );
+	csv.Write( "\n" );
+
+	wxFFile log( folder + "/" + job.file + ".log", "w" );
+
+	for( size_t i=0;i<job.sims.size();i++ )
+	{
+		Simulation *sim = job.sims[i];
+		csv.Write( CsvText( sim->GetName() ) + wxString::Format( ",%d,%d", sim->Ok() ? 1 : 0, sim->GetTotalElapsedTime() ) );
+		for( size_t j=0;j<names.size();j++ )
+		{
+			csv.Write( "," );
+			if ( VarValue *vv = sim->GetOutput( names[j] ) )
+			{
+				if ( vv->Type() == VV_NUMBER )
+					csv.Write( wxString::Format( "%.17g", (double)vv->Value() ) );
+				else if ( vv->Type() == VV_STRING )
+					csv.Write( CsvText( vv->String() ) );
+			}
+		}
+		csv.Write( "\n" );
+
+		if ( log.IsOpened() )
+		{
+			wxArrayString msgs = sim->GetAllMessages();
+			for( size_t j=0;j<msgs.size();j++ )
+				log.Write( sim->GetName() + ": " + msgs[j] + "\n" );
+		}
+
+		if ( all_outputs && sim->Ok() )
+		{
+			wxFFileOutputStream out( folder + "/" + job.file + "-" + SafeFileName( sim->GetName() ) + ".bin" );
+			if ( out.IsOk() )
+				sim->Outputs().Write( out );
+		}
+	}
+
+	return true;
+}
+
+class SamBatchApp : public wxAppConsole
+{
+public:
+	virtual bool OnInit() { return true; }
+	virtual int OnRun();
+	virtual int OnExit()
+	{
+		EqnEvaluator::StopThreads();
+		return wxAppConsole::OnExit();
+	}
+};
+
+int SamBatchApp::OnRun()
+{
+	wxCmdLineParser parser( g_cmdLineDesc, argc, argv );
+	parser.SetLogo( "SAM batch simulation runner " + SamApp::VersionStr() );
+	if ( parser.Parse() != 0 )
+		return 1;
+
+	bool verbose = parser.Found( "verbose" );
+	if ( !verbose )
+		wxLog::SetLogLevel( wxLOG_Warning );
+
+	wxArrayString args;
+	for( int i=0;i<argc;i++ )
+		args.Add( argv[i] );
+
+	if ( !SamApp::InitHeadless( args ) )
+		return 1;
+
+	wxString project_file = parser.GetParam( 0 );
+	ProjectFile &pf = SamApp::Project();
+	if ( !pf.ReadArchive( project_file ) )
+	{
+		wxFprintf( stderr, "error reading project %s: %s\n", project_file, pf.GetLastError() );
+		return 1;
+	}
+
+	wxString folder;
+	if ( !parser.Found( "output", &folder ) )
+	{
+		wxFileName fn( project_file );
+		fn.MakeAbsolute();
+		folder = fn.GetPath() + "/" + fn.GetName() + "_results";
+	}
+	if ( !wxDirExists( folder ) && !wxFileName::Mkdir( folder, 511, wxPATH_MKDIR_FULL ) )
+	{
+		wxFprintf( stderr, "could not create output folder %s\n", folder );
+		return 1;
+	}
+
+	long nthreads = wxThread::GetCPUCount();
+	parser.Found( "threads", &nthreads );
+	if ( nthreads < 1 ) nthreads = 1;
+
+	wxArrayString case_names = pf.GetCaseNames();
+	wxString buf;
+	if ( parser.Found( "cases", &buf ) )
+		case_names = wxSplit( buf, ',' );
+
+	wxArrayString selected;
+	if ( parser.Found( "select", &buf ) )
+		selected = wxSplit( buf, ',' );
+
+	bool all_outputs = parser.Found( "all-outputs" );
+	bool parametric = parser.Found( "parametric" );
+
+	wxString weather_folder;
+	wxArrayString weather_files;
+	std::vector<int> years;
+	if ( parser.Found( "p50p90", &weather_folder ) )
+	{
+		ListWeatherFiles( weather_folder, weather_files, years );
+		if ( weather_files.size() == 0 )
+		{
+			wxFprintf( stderr, "no weather files with a year in the name found in %s\n", weather_folder );
+			return 1;
+		}
+	}
+
+	std::vector<BatchJob> jobs;
+	for( size_t k=0;k<case_names.size();k++ )
+	{
+		Case *c = pf.GetCase( case_names[k] );
+		if ( !c )
+		{
+			wxFprintf( stderr, "no case named '%s' in %s\n", case_names[k], project_file );
+			return 1;
+		}
+
+		// all runs of a case share one copy of its values
+		std::shared_ptr<VarTable> base_inputs = std::make_shared<VarTable>( c->Values() );
+
+		BatchJob job;
+		job.outputs = selected;
+
+		if ( parametric )
+		{
+			ParametricData &par = c->Parametric();
+			size_t nruns = 0;
+			for( size_t j=0;j<par.Setup.size();j++ )
+			{
+				if ( par.Setup[j].IsInput )
+				{
+					if ( par.Setup[j].Values.size() > nruns )
+						nruns = par.Setup[j].Values.size();
+				}
+				else if ( selected.size() == 0 )
+					job.outputs.Add( par.Setup[j].Name );
+			}
+
+			for( size_t i=0;i<nruns;i++ )
+			{
+				Simulation *sim = new Simulation( c, wxString::Format( "Parametric #%d", (int)(i+1) ) );
+				sim->SetBaseInputs( base_inputs );
+				for( size_t j=0;j<par.Setup.size();j++ )
+					if ( par.Setup[j].IsInput && i < par.Setup[j].Values.size() )
+						sim->Override( par.Setup[j].Name, par.Setup[j].Values[i] );
+				job.sims.push_back( sim );
+			}
+			job.file = SafeFileName( case_names[k] ) + "-parametric";
+		}
+		else if ( weather_files.size() > 0 )
+		{
+			for( size_t i=0;i<weather_files.size();i++ )
+			{
+				Simulation *sim = new Simulation( c, wxString::Format( "Year %d", years[i] ) );
+				sim->SetBaseInputs( base_inputs );
+				sim->Override( "use_specific_weather_file", VarValue( true ) );
+				sim->Override( "user_specified_weather_file", VarValue( weather_files[i] ) );
+				sim->Override( "use_specific_wf_wind", VarValue( true ) );
+				sim->Override( "user_specified_wf_wind", VarValue( weather_files[i] ) );
+				job.sims.push_back( sim );
+			}
+			job.file = SafeFileName( case_names[k] ) + "-p50p90";
+		}
+		else
+		{
+			Simulation *sim = new Simulation( c, case_names[k] );
+			sim->SetBaseInputs( base_inputs );
+			job.sims.push_back( sim );
+			job.file = SafeFileName( case_names[k] );
+		}
+
+		for( size_t i=0;i<job.sims.size();i++ )
+		{
+			if ( job.outputs.size() > 0 && !all_outputs )
+				job.sims[i]->SetOutputFilter( job.outputs );
+			else if ( !all_outputs )
+				job.sims[i]->SetOutputFilter( true );
+		}
+
+		jobs.push_back( job );
+	}
+
+	// runs from every case go through one queue so that all threads stay busy
+	std::vector<Simulation*> sims;
+	for( size_t k=0;k<jobs.size();k++ )
+		sims.insert( sims.end(), jobs[k].sims.begin(), jobs[k].sims.end() );
+
+	wxPrintf( "running %d simulations on %d threads\n", (int)sims.size(), (int)nthreads );
+	fflush( stdout );
+
+	wxString trace_file;
+	bool trace = parser.Found( "trace", &trace_file );
+	SimulationTrace::Global().Enable( trace );
+
+	wxStopWatch sw;
+	ConsoleMonitor mon( nthreads < (long)sims.size() ? nthreads : (long)sims.size(), verbose );
+	int nok = Simulation::DispatchThreads( mon, sims, (int)nthreads, true );
+
+	wxPrintf( "%d of %d simulations succeeded in %.1f s, writing results to %s\n",
+		nok, (int)sims.size(), 0.001*sw.Time(), folder );
+
+	int code = ( nok == (int)sims.size() ) ? 0 : 2;
+	if ( trace && !SimulationTrace::Global().Write( trace_file ) )
+	{
+		wxFprintf( stderr, "error writing trace file %s\n", trace_file );
+		code = 1;
+	}
+
+	for( size_t k=0;k<jobs.size();k++ )
+	{
+		if ( !WriteResults( folder, jobs[k], all_outputs ) )
+		{
+			wxFprintf( stderr, "error writing results for %s\n", jobs[k].file );
+			code = 1;
+		}
+
+		for( size_t i=0;i<jobs[k].sims.size();i++ )
+			delete jobs[k].sims[i];
+	}
+
+	return code;
+}
+
+wxIMPLEMENT_APP_CONSOLE( SamBatchApp );
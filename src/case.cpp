@@ -22,6 +22,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <wx/datstrm.h>
 #include <wx/wfstream.h>
+#include <wx/thread.h>
 
 #include <wex/utils.h>
 
@@ -30,6 +31,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "main.h"
 #include "library.h"
 #include "invoke.h"
+#include "defcache.h"
 #include <lk/stdlib.h>
 
      
@@ -142,7 +144,22 @@ void CaseEvaluator::SetupEnvironment( lk::env_t &env )
 	env.register_func( fcall_technology_pCase, m_case );
 	env.register_func( fcall_financing_pCase, m_case );
 	env.register_funcs( invoke_ssc_funcs() );
-	env.register_funcs( invoke_equation_funcs() );
+
+	// batch simulations prepare on worker threads, where the
+	// functions that open dialogs or use the main window can't run
+	if ( wxThread::IsMain() )
+		env.register_funcs( invoke_equation_funcs() );
+	else
+		env.register_funcs( invoke_equation_thread_funcs() );
+}
+
+void CaseEvaluator::SetupParallelEnvironment( lk::env_t &env )
+{
+	EqnEvaluator::SetupParallelEnvironment( env );
+
+	// these only read the case's configuration names
+	env.register_func( fcall_technology_pCase, m_case );
+	env.register_func( fcall_financing_pCase, m_case );
 }
 	
 int CaseEvaluator::CalculateAll()
@@ -233,11 +250,11 @@ bool CaseEvaluator::UpdateLibrary( const wxString &trigger, wxArrayString &chang
 				// find the entry
 				int entry = lib->FindEntry( vv->String() );
 								
-				if (entry < 0 || !lib->ApplyEntry(entry, varindex, *m_vt, changed))
+				wxArrayString errs;
+				if (entry < 0 || !lib->ApplyEntry(entry, varindex, *m_vt, changed, errs))
 				{
 //					nerrors++;
 //					m_errors.Add("Library error: '" + vv->String() + "'  is not available in the " + name + " library." );
-					wxArrayString errs( lib->GetErrors() );
 					for (size_t k = 0; k < errs.size(); k++)
 					{
 						if (!errs[k].IsEmpty())
@@ -516,6 +533,11 @@ bool Case::LoadValuesFromExternalSource( wxInputStream &in,
 		return false;
 	}
 
+	return LoadValuesFromExternalSource( vt, di, oldvals );
+}
+
+bool Case::LoadValuesFromExternalSource( VarTable &vt, LoadStatus *di, VarTable *oldvals )
+{
 	if ( di ) di->nread = vt.size();
 
 	bool ok = (vt.size() == m_vals.size());
@@ -576,14 +598,30 @@ bool Case::LoadDefaults( wxString *pmsg )
 	bool ok = false;
 	if ( wxFileExists(file) )
 	{
-		wxFFileInputStream in(file);
-		if (!in.IsOk())
+		if ( binary )
 		{
-			if ( pmsg ) *pmsg = "Could not open defaults file";
-			return false;
+			wxFFileInputStream in(file);
+			if (!in.IsOk())
+			{
+				if ( pmsg ) *pmsg = "Could not open defaults file";
+				return false;
+			}
+
+			ok = LoadValuesFromExternalSource( in, &di, (VarTable *)0, binary );
 		}
-	
-		ok = LoadValuesFromExternalSource( in, &di, (VarTable *)0, binary );
+		else
+		{
+			// text defaults are read through their binary copy when it is current
+			VarTable vt;
+			if ( DefaultsCache::Read( file, vt ) )
+				ok = LoadValuesFromExternalSource( vt, &di );
+			else
+			{
+				di.error = "Error reading inputs from external source";
+				wxLogStatus( di.error );
+			}
+		}
+
 		message = wxString::Format("Defaults file is likely out of date: " + wxFileNameFromPath(file) + "\n\n"
 				"Variables: %d loaded but not in configuration, %d wrong type, defaults file has %d, config has %d\n\n"
 				"Would you like to update the defaults with the current values right now?\n"
@@ -672,12 +710,12 @@ bool Case::SetConfiguration( const wxString &tech, const wxString &fin, bool sil
 	VarTable vt_defaults;
 	if ( wxFileExists(file))
 	{
+#ifdef UI_BINARY
 		wxFFileInputStream in(file);
 		if ( in.IsOk() )
-#ifdef UI_BINARY
 			vt_defaults.Read( in );
 #else
-			vt_defaults.Read_text(in);
+		DefaultsCache::Read( file, vt_defaults );
 #endif
 	}
 
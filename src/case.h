@@ -111,6 +111,8 @@ public:
 
 	bool LoadValuesFromExternalSource( wxInputStream &in, 
 		LoadStatus *di = 0, VarTable *invalids = 0, bool binary = true );
+	bool LoadValuesFromExternalSource( VarTable &vt,
+		LoadStatus *di = 0, VarTable *invalids = 0 );
 
 	bool LoadDefaults( wxString *error_msg = 0 );
 	bool SaveDefaults( bool quiet = false );
@@ -205,6 +207,7 @@ class CaseEvaluator : public EqnEvaluator
 public:	
 	CaseEvaluator( Case *cc, VarTable &vars, EqnFastLookup &efl );
 	virtual void SetupEnvironment( lk::env_t &env );	
+	virtual void SetupParallelEnvironment( lk::env_t &env );
 	virtual int CalculateAll();
 	virtual int Changed( const wxArrayString &vars );
 	virtual int Changed( const wxString &trigger );
@@ -0,0 +1,134 @@
+/**
+BSD-3-Clause
+Copyright 2019 Alliance for Sustainable Energy, LLC
+Redistribution and use in source and binary forms, with or without modification, are permitted provided
+that the following conditions are met :
+1.	Redistributions of source code must retain the above copyright notice, this list of conditions
+and the following disclaimer.
+2.	Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+and the following disclaimer in the documentation and/or other materials provided with the distribution.
+3.	Neither the name of the copyright holder nor the names of its contributors may be used to endorse
+or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER, CONTRIBUTORS, UNITED STATES GOVERNMENT OR UNITED STATES
+DEPARTMENT OF ENERGY, NOR ANY OF THEIR EMPLOYEES, BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+OR CONSEQUENTIAL DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <wx/datstrm.h>
+#include <wx/wfstream.h>
+#include <wx/filename.h>
+#include <wx/datetime.h>
+#include <wx/dir.h>
+#include <wx/log.h>
+#include <wx/utils.h>
+
+#include "defcache.h"
+#include "variables.h"
+#include "main.h"
+
+#define DEFCACHE_CODE 0xd7
+#define DEFCACHE_VERSION 2
+#define DEFCACHE_SETTLE_MS 2000
+
+static wxUint64 path_hash( const wxString &path )
+{
+	// 64 bit FNV-1a, only used to give each defaults file its own copy
+	wxScopedCharBuffer utf8 = path.utf8_str();
+	wxUint64 h = 14695981039346656037ULL;
+	for( size_t i=0;i<utf8.length();i++ )
+		h = ( h ^ (unsigned char)utf8.data()[i] ) * 1099511628211ULL;
+	return h;
+}
+
+wxString DefaultsCache::Folder()
+{
+	return SamApp::GetUserLocalDataDir() + "/defaults-cache";
+}
+
+void DefaultsCache::Clear()
+{
+	wxArrayString files;
+	if ( wxDirExists( Folder() ) )
+		wxDir::GetAllFiles( Folder(), &files, "*.bin", wxDIR_FILES );
+	for( size_t i=0;i<files.size();i++ )
+		wxRemoveFile( files[i] );
+}
+
+bool DefaultsCache::Read( const wxString &file, VarTable &tab )
+{
+	wxFileName fn( file );
+	fn.MakeAbsolute();
+	wxString path = fn.GetFullPath();
+	wxULongLong size = fn.GetSize();
+	if ( size == wxInvalidSize ) return false;
+	wxInt64 mtime = fn.GetModificationTime().GetValue().GetValue();
+
+	wxString cache = Folder() + "/" + fn.GetName()
+		+ wxString::Format( "-%016" wxLongLongFmtSpec "x.bin", path_hash( path ) );
+	if ( wxFileExists( cache ) )
+	{
+		wxFFileInputStream is( cache );
+		if ( is.IsOk() )
+		{
+			wxDataInputStream in( is );
+			if ( in.Read8() == DEFCACHE_CODE
+				&& in.Read8() == DEFCACHE_VERSION
+				&& in.ReadString() == path
+				&& in.Read64() == size.GetValue()
+				&& (wxInt64)in.Read64() == mtime
+				&& tab.Read( is )
+				&& in.Read8() == DEFCACHE_CODE )
+				return true;
+		}
+
+		wxLogStatus( "DefaultsCache: rebuilding " + cache );
+	}
+
+	// a copy that failed part way may have left values behind
+	tab.clear();
+	if ( !tab.Read_text( file ) )
+		return false;
+
+	// a file modified within the timestamp resolution could change again
+	// without its time or size changing, so only copy files that settled
+	wxInt64 age = wxDateTime::UNow().GetValue().GetValue() - mtime;
+	if ( age < DEFCACHE_SETTLE_MS )
+		return true;
+
+	// write to a temporary file first so that another instance never
+	// sees a partial copy
+	if ( !wxDirExists( Folder() ) && !wxFileName::Mkdir( Folder(), 511, wxPATH_MKDIR_FULL ) )
+		return true;
+
+	wxString temp = cache + wxString::Format( ".%lu.tmp", wxGetProcessId() );
+	bool ok = false;
+	{
+		wxFFileOutputStream os( temp );
+		if ( os.IsOk() )
+		{
+			wxDataOutputStream out( os );
+			out.Write8( DEFCACHE_CODE );
+			out.Write8( DEFCACHE_VERSION );
+			out.WriteString( path );
+			out.Write64( size.GetValue() );
+			out.Write64( (wxUint64)mtime );
+
+			// copies are only read by builds that made them
+			NumericEncodingScope encode;
+			tab.Write( os );
+			out.Write8( DEFCACHE_CODE );
+			ok = os.IsOk() && os.Close();
+		}
+	}
+
+	if ( !ok || !wxRenameFile( temp, cache, true ) )
+		wxRemoveFile( temp );
+
+	return true;
+}
@@ -29,6 +29,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "main.h"
 #include "casewin.h"
 #include "defmgr.h"
+#include "defcache.h"
  
 
 static wxString GetDefaultsFile( const wxString &t, const wxString &f )
@@ -130,7 +131,7 @@ void ValueEditor::ValueToForm()
 		if ( m_val.Length() > 0 )
 		{
 			size_t nn;
-			double *p = m_val.Array( &nn );
+			const double *p = m_val.Array( &nn );
 			mat.resize_fill( nn, 0.0f );
 			for( size_t i=0;i<nn;i++ )
 				mat.at(i) = p[i];
@@ -380,7 +381,7 @@ void DefaultsManager::OnSaveAsType(wxCommandEvent &evt)
 #ifdef UI_BINARY
 			if (!tab.Read(file))
 #else
-			if (!tab.Read_text(file))
+			if (!DefaultsCache::Read(file, tab))
 #endif
 			{
 				Log("file read error: " + file);
@@ -442,7 +443,7 @@ void DefaultsManager::OnQuery(wxCommandEvent &)
 #ifdef UI_BINARY
 		if ( !tab.Read( file ))			
 #else
-		if (!tab.Read_text(file))
+		if (!DefaultsCache::Read(file, tab))
 #endif
 		{
 			Log("file error: " + file);
@@ -470,7 +471,7 @@ void DefaultsManager::OnLoad( wxCommandEvent & )
 #ifdef UI_BINARY
 	if (!tab.Read(file))
 #else
-	if (!tab.Read_text(file))
+	if (!DefaultsCache::Read(file, tab))
 #endif
 	{
 		Log("file read error: " + file);
@@ -505,7 +506,7 @@ void DefaultsManager::OnModify( wxCommandEvent & )
 #ifdef UI_BINARY
 		if (!tab.Read(file))
 #else
-		if (!tab.Read_text(file))
+		if (!DefaultsCache::Read(file, tab))
 #endif
 		{
 			Log("file read error: " + file);
@@ -551,7 +552,7 @@ void DefaultsManager::OnModify( wxCommandEvent & )
 			else if ( vv->Type() == VV_ARRAY )
 			{	
 				size_t arrlen;
-				double *arr = value.Array( & arrlen );
+				const double *arr = value.Array( & arrlen );
 				wxString s("Set '" + name + "' in " + m_techList[i] + ", " + m_finList[i]  + " (" + GetTypeStr( vv->Type() ) + ") = ");
 				if ( arrlen > 25 )
 				{
@@ -599,7 +600,7 @@ void DefaultsManager::OnDeleteVar(wxCommandEvent &)
 #ifdef UI_BINARY
 		if ( !tab.Read( file ) )
 #else
-		if (!tab.Read_text(file))
+		if (!DefaultsCache::Read(file, tab))
 #endif
 		{
 			Log("read error: " + file );
@@ -20,15 +20,22 @@ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE
 OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <queue>
+
 #include <wx/tokenzr.h>
 #include <wx/log.h>
 #include <wx/file.h>
 #include <wx/datstrm.h>
+#include <wx/thread.h>
 
 #include <lk/parse.h>
 #include <lk/env.h>
 #include <lk/stdlib.h>
 #include <lk/eval.h>
+#include <lk/vm.h>
 
 #include "equations.h"
 
@@ -177,7 +184,7 @@ bool EqnDatabase::Parse( lk::input_base &in, wxArrayString *errors )
 				if ( outputs.size() > 0 && equation != 0 )
 				{
 					// now save the equation in the database
-					AddEquation( inputs, outputs, equation, result_is_output );
+					AddEquation( inputs, outputs, equation, result_is_output, Compile( value.func() ) );
 
 					neqns_found++;
 				}
@@ -209,7 +216,11 @@ void EqnDatabase::Clear()
 	for ( std::vector<EqnData*>::iterator it = m_equations.begin();
 		it != m_equations.end();
 		++it )
-		delete (*it); // don't delete the tree here: just a reference and will be deleted below.
+	{
+		// don't delete the tree here: just a reference and will be deleted below.
+		if ( (*it)->code ) delete (*it)->code;
+		delete (*it);
+	}
 
 	m_equations.clear();
 
@@ -220,14 +231,116 @@ void EqnDatabase::Clear()
 }
 
 
-bool EqnDatabase::AddEquation( const wxArrayString &inputs, const wxArrayString &outputs, lk::node_t *tree, bool result_is_output )
+static void ScanCalls( lk::node_t *root, wxArrayString *calls )
+{
+	if (!root) return;
+
+	if ( lk::list_t *n = dynamic_cast<lk::list_t*>( root ) )
+	{
+		for( size_t i=0;i<n->items.size();i++ )
+			ScanCalls( n->items[i], calls );
+	}
+	else if ( lk::iter_t *n = dynamic_cast<lk::iter_t*>( root ) )
+	{
+		ScanCalls( n->init, calls );
+		ScanCalls( n->test, calls );
+		ScanCalls( n->adv, calls );
+		ScanCalls( n->block, calls );
+	}
+	else if ( lk::cond_t *n = dynamic_cast<lk::cond_t*>( root ) )
+	{
+		ScanCalls( n->test, calls );
+		ScanCalls( n->on_true, calls );
+		ScanCalls( n->on_false, calls );
+	}
+	else if ( lk::expr_t *n = dynamic_cast<lk::expr_t*>( root ) )
+	{
+		if ( n->oper == lk::expr_t::CALL || n->oper == lk::expr_t::THISCALL )
+		{
+			lk::iden_t *id = dynamic_cast<lk::iden_t*>( n->left );
+			wxString name( n->oper == lk::expr_t::CALL && id != 0 && !id->special ? id->name : wxString() );
+			if ( calls->Index( name ) == wxNOT_FOUND )
+				calls->Add( name );
+		}
+
+		ScanCalls( n->left, calls );
+		ScanCalls( n->right, calls );
+	}
+	else if ( lk::ctlstmt_t *n = dynamic_cast<lk::ctlstmt_t*>( root ) )
+	{
+		ScanCalls( n->rexpr, calls );
+	}
+}
+
+static lk::expr_t *FindCall( lk::node_t *root, const char *name )
+{
+	if ( lk::list_t *n = dynamic_cast<lk::list_t*>( root ) )
+	{
+		for( size_t i=0;i<n->items.size();i++ )
+			if ( lk::expr_t *call = FindCall( n->items[i], name ) )
+				return call;
+	}
+	else if ( lk::expr_t *n = dynamic_cast<lk::expr_t*>( root ) )
+	{
+		if ( n->oper == lk::expr_t::CALL )
+			if ( lk::iden_t *id = dynamic_cast<lk::iden_t*>( n->left ) )
+				if ( id->name == name )
+					return n;
+
+		if ( lk::expr_t *call = FindCall( n->left, name ) ) return call;
+		return FindCall( n->right, name );
+	}
+
+	return 0;
+}
+
+lk::bytecode *EqnDatabase::Compile( lk::expr_t *func )
+{
+	// the equation's definition is called from a one line script so that the
+	// vm leaves its result in a variable.  the definition is only borrowed
+	// for code generation, and is handed back before the script is deleted
+	lk::input_string in( "__result__ = __equation__();" );
+	lk::parser parse( in );
+	lk::node_t *script = parse.script();
+	lk::expr_t *call = FindCall( script, "__equation__" );
+	if ( parse.error_count() != 0 || call == 0 )
+	{
+		if ( script ) delete script;
+		return 0;
+	}
+
+	lk::node_t *name = call->left;
+	call->left = func;
+
+	lk::codegen cg;
+	lk::bytecode *code = 0;
+	if ( cg.generate( script ) )
+	{
+		code = new lk::bytecode;
+		cg.get( *code );
+	}
+
+	call->left = name;
+	delete script;
+
+	// equations that can't be compiled still run on the interpreter
+	return code;
+}
+
+bool EqnDatabase::AddEquation( const wxArrayString &inputs, const wxArrayString &outputs, lk::node_t *tree, bool result_is_output, lk::bytecode *code )
 {
 
 	EqnData *ed = new EqnData;
 	ed->tree = tree;
+	ed->code = code;
+	ScanCalls( tree, &ed->calls );
 	ed->inputs = inputs;
 	ed->outputs = outputs;
 	ed->result_is_output = result_is_output;
+	for( size_t i=0;i<inputs.size();i++ )
+		ed->input_ids.push_back( SymbolTable::Intern( inputs[i] ) );
+	for( size_t i=0;i<outputs.size();i++ )
+		ed->output_ids.push_back( SymbolTable::Intern( outputs[i] ) );
 	m_equations.push_back( ed );
 
 	for( size_t i=0;i<ed->outputs.size();i++ )
@@ -280,11 +393,13 @@ wxArrayString *EqnDatabase::GetAffectedVariables( const wxString &var )
 }
 
 EqnFastLookup::EqnFastLookup()
+	: m_planOk( false ), m_eqnIndexById( -1 )
 {
 	// nothing to do
 }
 
 EqnFastLookup::EqnFastLookup( EqnDatabase *db )
+	: m_planOk( false ), m_eqnIndexById( -1 )
 {
 	m_dbs.push_back( db );
 }
@@ -297,6 +412,7 @@ void EqnFastLookup::AddDatabase( EqnDatabase *db )
 void EqnFastLookup::Add( EqnData *e )
 {
 	m_eqnList.push_back( e );
+	m_planOk = false;
 
 	for( size_t i=0;i<e->outputs.size();i++)
 	{
@@ -305,6 +421,7 @@ void EqnFastLookup::Add( EqnData *e )
 		// update fast lookup
 		m_eqnLookup[ output ] = e;
 		m_eqnIndices[ output ] = m_eqnList.size()-1;
+		m_eqnIndexById.Set( e->output_ids[i], (int)m_eqnList.size()-1 );
 	}
 }
 
@@ -319,7 +436,106 @@ void EqnFastLookup::Clear()
 	// clear the equation fast lookup tables
 	m_eqnLookup.clear();
 	m_eqnIndices.clear();
-	
+	m_eqnIndexById.Clear();
+	m_planOk = false;
+}
+
+void EqnFastLookup::Compile()
+{
+	wxMutexLocker _lock( m_planLock );
+	CompilePlan();
+}
+
+const EqnFastLookup::Plan &EqnFastLookup::GetPlan()
+{
+	if ( !m_planOk )
+	{
+		wxMutexLocker _lock( m_planLock );
+		if ( !m_planOk )
+			CompilePlan();
+	}
+
+	return m_plan;
+}
+
+void EqnFastLookup::CompilePlan()
+{
+	size_t neqns = m_eqnList.size();
+	m_plan.order.clear();
+	m_plan.levels.clear();
+	m_plan.cyclic.clear();
+	m_plan.deps.assign( neqns, std::vector<int>() );
+	m_plan.users.assign( neqns, std::vector<int>() );
+	m_plan.readers.clear();
+
+	// link each equation to the ones computing its inputs
+	std::vector<int> nwaiting( neqns, 0 );
+	for( size_t i=0;i<neqns;i++ )
+	{
+		std::vector<int> &deps = m_plan.deps[i];
+		const std::vector<SymbolId> &inputs = m_eqnList[i]->input_ids;
+		for( size_t j=0;j<inputs.size();j++ )
+		{
+			m_plan.readers[ m_eqnList[i]->inputs[j] ].push_back( (int)i );
+
+			int idx = GetEquationIndex( inputs[j] );
+			if ( idx >= 0 && idx < (int)neqns
+				&& std::find( deps.begin(), deps.end(), idx ) == deps.end() )
+			{
+				deps.push_back( idx );
+				m_plan.users[idx].push_back( (int)i );
+			}
+		}
+		nwaiting[i] = (int)deps.size();
+	}
+
+	// topological sort, taking the lowest ready index first so equations
+	// keep the order they were defined in wherever the inputs allow it
+	std::priority_queue< int, std::vector<int>, std::greater<int> > ready;
+	for( size_t i=0;i<neqns;i++ )
+		if ( nwaiting[i] == 0 )
+			ready.push( (int)i );
+
+	m_plan.order.reserve( neqns );
+	while( !ready.empty() )
+	{
+		int i = ready.top();
+		ready.pop();
+		m_plan.order.push_back( i );
+
+		std::vector<int> &users = m_plan.users[i];
+		for( size_t k=0;k<users.size();k++ )
+			if ( --nwaiting[ users[k] ] == 0 )
+				ready.push( users[k] );
+	}
+
+	// an equation's level is one past the deepest equation it depends on,
+	// so the equations within a level can be evaluated in any order
+	std::vector<int> level( neqns, 0 );
+	for( size_t k=0;k<m_plan.order.size();k++ )
+	{
+		int i = m_plan.order[k];
+		const std::vector<int> &deps = m_plan.deps[i];
+		for( size_t j=0;j<deps.size();j++ )
+			level[i] = std::max( level[i], level[ deps[j] ] + 1 );
+
+		if ( level[i] >= (int)m_plan.levels.size() )
+			m_plan.levels.resize( level[i] + 1 );
+		m_plan.levels[ level[i] ].push_back( i );
+	}
+
+	// anything left waits on a cycle and can never be evaluated
+	for( size_t i=0;i<neqns;i++ )
+	{
+		if ( nwaiting[i] > 0 )
+		{
+			m_plan.cyclic.push_back( (int)i );
+			wxLogStatus( "equation cycle: [" + wxJoin( m_eqnList[i]->outputs, ',' )
+				+ "] = f( " + wxJoin( m_eqnList[i]->inputs, ',' ) + " )" );
+		}
+	}
+
+	m_planOk = true;
 }
 
 size_t EqnFastLookup::GetAffectedVariables( const wxString &var, wxArrayString &list, eqnmark_hash_t &ignore )
@@ -369,16 +585,283 @@ int EqnFastLookup::GetEquationIndex( const wxString &var )
 
 
 
+class EqnVM : public lk::vm
+{
+	VarTableSpecials m_specials;
+public:
+	EqnVM( VarTable *vt ) : m_specials( vt ) { }
+
+	virtual bool special_set( const lk_string &name, lk::vardata_t &val ) { return m_specials.Set( name, val ); }
+	virtual bool special_get( const lk_string &name, lk::vardata_t &val ) { return m_specials.Get( name, val ); }
+
+	VarTableSpecials &Specials() { return m_specials; }
+};
+
+// runs one equation with the given function table, on the vm when it was
+// compiled (unless told not to) and on the interpreter otherwise.  the
+// equation's variables live in a scope of its own, so the function table is
+// only read and can be shared by threads
+static bool RunEquation( EqnData *eqn, VarTable &vars, lk::env_t &funcs, EqnVM *&vm, wxArrayString &errors, bool compiled )
+{
+	lk::env_t env( &funcs );
+
+#ifdef _DEBUG
+	wxLogStatus( "solving... [" + wxJoin(eqn->outputs, ',') 
+		+ "] = f( " + wxJoin(eqn->inputs, ',') + " )" );
+#endif
+
+	if ( compiled && eqn->code != 0 )
+	{
+		if ( !vm ) vm = new EqnVM( &vars );
+
+		// the compiled wrapper assigns the equation's result to
+		// __result__ in the top level scope, which is env
+		vm->load( eqn->code );
+		bool run_ok = vm->initialize( &env ) && vm->run();
+		wxString err = run_ok ? wxString() : wxString( vm->error() );
+		if ( run_ok && eqn->result_is_output && eqn->outputs.size() == 1 )
+		{
+			if ( lk::vardata_t *result = env.lookup( "__result__", false ) )
+				vm->Specials().Set( eqn->outputs[0], result->deref() );
+			else
+			{
+				err = "equation did not produce a result";
+				run_ok = false;
+			}
+		}
+
+		if ( !run_ok )
+		{
+			errors.Add( "equation engine: " + err );
+			errors.Add( "fail: [" + wxJoin(eqn->outputs, ',') 
+				+ "] = f( " + wxJoin(eqn->inputs, ',') + " )" );
+			return false;
+		}
+
+		return true;
+	}
+
+	VarTableScriptInterpreter e( eqn->tree, &env, &vars );
+
+	// execute the parse tree, check for errors
+	bool run_ok = e.run();
+	if ( !run_ok )
+	{
+		for ( size_t m=0;m<e.error_count();m++ )
+			errors.Add( "equation engine: " + e.get_error(m) );
+
+		errors.Add( "fail: [" + wxJoin(eqn->outputs, ',') 
+			+ "] = f( " + wxJoin(eqn->inputs, ',') + " )" );
+		return false;
+	}
+
+	// for equations with a single output (not MIMOs)
+	// the result of expression evaluation is
+	// the value of the single output variable 
+	// (i.e. via the 'return' statement)
+	if ( eqn->result_is_output && eqn->outputs.size() == 1 )
+		e.special_set( eqn->outputs[0], e.result().deref() );
+
+	return true;
+}
+
+// process wide worker threads that evaluate batches of independent
+// equations for every evaluator.  they are started the first time a batch
+// is run and kept until the application exits, so a recalculation doesn't
+// pay for starting threads.  each worker keeps its own vm, the calling
+// thread takes part with the evaluator's vm, and all of them share the
+// evaluator's function table, which equations only read.  results and
+// errors go to per-equation slots merged by the caller.  the caller makes
+// sure that no variable is added to the table during a batch and that no
+// two equations in a batch write the same variable
+class EqnPool
+{
+	class Worker : public wxThread
+	{
+		EqnPool *m_pool;
+	public:
+		Worker( EqnPool *pool ) : wxThread( wxTHREAD_JOINABLE ), m_pool( pool ), vm( 0 ) { }
+		virtual ~Worker() { if ( vm ) delete vm; }
+
+		EqnVM *vm;
+
+		virtual void *Entry()
+		{
+			m_pool->Loop( *this );
+			return 0;
+		}
+	};
+
+public:
+	static EqnPool &Get( size_t nworkers );
+	static void Stop();
+
+	// evaluates the batch on the workers and the calling thread.  only one
+	// batch runs at a time, so this returns false without evaluating
+	// anything while another evaluator is using the pool
+	bool Run( const std::vector<EqnData*> &batch, VarTable &vars, lk::env_t &funcs, bool compiled, EqnVM *&vm,
+		std::vector<char> &ok, std::vector<wxArrayString> &errors )
+	{
+		if ( m_runLock.TryLock() != wxMUTEX_NO_ERROR )
+			return false;
+
+		ok.assign( batch.size(), 0 );
+		errors.assign( batch.size(), wxArrayString() );
+
+		m_lock.Lock();
+		m_batch = &batch;
+		m_vars = &vars;
+		m_funcs = &funcs;
+		m_compiled = compiled;
+		m_ok = &ok;
+		m_errors = &errors;
+		m_next = 0;
+		m_busy = m_workers.size();
+		m_round++;
+		m_wake.Broadcast();
+		m_lock.Unlock();
+
+		Drain( vm );
+
+		m_lock.Lock();
+		while( m_busy > 0 )
+			m_done.Wait();
+		m_batch = 0;
+		m_lock.Unlock();
+
+		m_runLock.Unlock();
+		return true;
+	}
+
+private:
+	EqnPool( size_t nworkers )
+		: m_wake( m_lock ), m_done( m_lock ), m_batch( 0 ), m_vars( 0 ), m_funcs( 0 ), m_compiled( true ),
+		m_ok( 0 ), m_errors( 0 ), m_round( 0 ), m_busy( 0 ), m_quit( false )
+	{
+		m_next = 0;
+		for( size_t i=0;i<nworkers;i++ )
+		{
+			Worker *w = new Worker( this );
+			if ( w->Create() == wxTHREAD_NO_ERROR && w->Run() == wxTHREAD_NO_ERROR )
+			{
+				wxMutexLocker _lock( m_lock );
+				m_workers.push_back( w );
+			}
+			else
+				delete w;
+		}
+	}
+
+	~EqnPool()
+	{
+		m_lock.Lock();
+		m_quit = true;
+		m_wake.Broadcast();
+		m_lock.Unlock();
+
+		for( size_t i=0;i<m_workers.size();i++ )
+		{
+			m_workers[i]->Wait();
+			delete m_workers[i];
+		}
+	}
+
+	void Drain( EqnVM *&vm )
+	{
+		// a vm reads the values of the table it was created for
+		if ( vm && vm->Specials().Table() != m_vars )
+		{
+			delete vm;
+			vm = 0;
+		}
+
+		size_t k;
+		while( (k = m_next++) < m_batch->size() )
+			(*m_ok)[k] = RunEquation( (*m_batch)[k], *m_vars, *m_funcs, vm, (*m_errors)[k], m_compiled ) ? 1 : 0;
+	}
+
+	void Loop( Worker &w )
+	{
+		unsigned long seen = 0;
+		m_lock.Lock();
+		for( ;; )
+		{
+			while( !m_quit && m_round == seen )
+				m_wake.Wait();
+			if ( m_quit ) break;
+
+			seen = m_round;
+			m_lock.Unlock();
+			Drain( w.vm );
+			m_lock.Lock();
+
+			if ( --m_busy == 0 )
+				m_done.Signal();
+		}
+		m_lock.Unlock();
+	}
+
+	std::vector<Worker*> m_workers;
+	wxMutex m_runLock;
+
+	wxMutex m_lock;
+	wxCondition m_wake, m_done;
+	const std::vector<EqnData*> *m_batch;
+	VarTable *m_vars;
+	lk::env_t *m_funcs;
+	bool m_compiled;
+	std::vector<char> *m_ok;
+	std::vector<wxArrayString> *m_errors;
+	std::atomic<size_t> m_next;
+	unsigned long m_round;
+	size_t m_busy;
+	bool m_quit;
+};
+
+static wxMutex gs_eqnPoolLock;
+static EqnPool *gs_eqnPool = 0;
+
+EqnPool &EqnPool::Get( size_t nworkers )
+{
+	// sized by the first evaluator to use it
+	wxMutexLocker _lock( gs_eqnPoolLock );
+	if ( !gs_eqnPool )
+		gs_eqnPool = new EqnPool( nworkers );
+	return *gs_eqnPool;
+}
+
+void EqnPool::Stop()
+{
+	wxMutexLocker _lock( gs_eqnPoolLock );
+	if ( gs_eqnPool )
+	{
+		delete gs_eqnPool;
+		gs_eqnPool = 0;
+	}
+}
+
 EqnEvaluator::EqnEvaluator( VarTable &vars, EqnFastLookup &fl )
-	: m_vars( vars ), m_efl( fl )
+	: m_vars( vars ), m_efl( fl ), m_cutoff( false ), m_envReady( false ), m_vm( 0 ), m_compiled( true ),
+	m_threads( 1 ), m_minBatch( 8 ), m_parallelReady( false )
 {
 	Reset();
 }
 
+EqnEvaluator::~EqnEvaluator()
+{
+	if ( m_vm ) delete m_vm;
+}
+
+void EqnEvaluator::StopThreads()
+{
+	EqnPool::Stop();
+}
+
 void EqnEvaluator::Reset()
 {
 	m_eqns = m_efl.GetEquations();
 	m_status.resize( m_eqns.size(), INVALID );
+	m_parallel.clear();
 	m_errors.Clear();
 	m_updated.Clear();
 }
@@ -388,158 +871,281 @@ int EqnEvaluator::CalculateAll()
 	// invalidate all equations
 	for( size_t i=0;i<m_status.size();i++ ) m_status[i] = INVALID;
 
+	m_cutoff = false;
 	return Calculate( );
 }
 
 
 int EqnEvaluator::Calculate( )
 {
-	std::vector<size_t> remaining;
+	size_t ninvalid = 0;
 	for( size_t i=0;i<m_status.size();i++ )
 		if ( m_status[i] == INVALID )
-			remaining.push_back( i );
+			ninvalid++;
 
-	if ( remaining.size() == 0 ) return 0; // all equations up to date
+	if ( ninvalid == 0 ) return 0; // all equations up to date
 
-	size_t ncalculated; // count all equations processed in current interation
-	size_t niterations = 0;
 	size_t nevals = 0; // number of equations evaluated
+	m_changed.assign( m_status.size(), 0 );
 
 //	wxLogStatus("Calculating equations...");
-	
-	do
+
+	if ( m_threads > 1 )
+		nevals = CalculateLevels( );
+	else
 	{
-		niterations++;
-		ncalculated = 0;
+		// the plan puts every equation after the ones computing its inputs,
+		// so a single pass evaluates everything that can be evaluated
+		const EqnFastLookup::Plan &plan = m_efl.GetPlan();
+		for( size_t k=0;k<plan.order.size();k++ )
+		{
+			size_t i = (size_t)plan.order[k];
+			if ( NeedsEvaluation( i, plan ) && Evaluate( i ) )
+				nevals++;
+		}
+	}
+
+	std::vector<size_t> remaining;
+	for( size_t i=0;i<m_status.size();i++ )
+		if ( m_status[i] != OK )
+			remaining.push_back( i );
 
-		// pass through all the equations in the list
-		for( size_t i=0;i<m_status.size();i++ )
+	if ( remaining.size() > 0 )
+	{
+		m_errors.Add( "no variables calculated in a single iteration, cannot make progress!" );
+		for (size_t i=0;i<remaining.size();i++)
 		{
-			EqnData *cur_eqn = m_eqns[i];
+			EqnData *eqn = m_eqns[ remaining[i] ];
+			m_errors.Add("eqn not evaluated: [" + wxJoin(eqn->outputs, ',') + "] = f( " + wxJoin(eqn->inputs,',') + ")");
+		}
+	
+		return -1;
+	}
 
-			// skip equations that have already been evaluated
-			if ( m_status[i] == OK )
-				continue;
+	return nevals;
+}
+
+int EqnEvaluator::CalculateLevels( )
+{
+	// the calling thread takes part in every batch
+	EqnPool &pool = EqnPool::Get( (size_t)m_threads - 1 );
 
-			wxArrayString &inputs = cur_eqn->inputs;
+	if ( !m_parallelReady )
+	{
+		SetupParallelEnvironment( m_parallelEnv );
+		m_parallelReady = true;
+	}
 
-			// check that all inputs for the current equation have already been evaluated
-			bool can_eval = true;
-			for( size_t j=0;j<inputs.Count();j++ )
+	if ( m_parallel.size() != m_eqns.size() )
+	{
+		// an equation can go to a worker only if every function it calls
+		// is one of the functions registered for the workers
+		std::vector<lk_string> list = m_parallelEnv.list_funcs();
+		wxArrayString safe;
+		for( size_t i=0;i<list.size();i++ )
+			safe.Add( list[i] );
+
+		m_parallel.assign( m_eqns.size(), 1 );
+		for( size_t i=0;i<m_eqns.size();i++ )
+			for( size_t j=0;j<m_eqns[i]->calls.size();j++ )
+				if ( safe.Index( m_eqns[i]->calls[j] ) == wxNOT_FOUND )
+					m_parallel[i] = 0;
+	}
+
+	size_t nevals = 0;
+	const EqnFastLookup::Plan &plan = m_efl.GetPlan();
+	std::vector<size_t> serial, batch;
+	std::vector<EqnData*> batch_eqns;
+	std::vector<char> ok;
+	std::vector<wxArrayString> errors;
+	std::vector< std::vector<VarValue> > saved;
+	SymbolMap<char> written;
+	for( size_t l=0;l<plan.levels.size();l++ )
+	{
+		const std::vector<int> &level = plan.levels[l];
+
+		serial.clear();
+		batch.clear();
+		written.Clear();
+		for( size_t k=0;k<level.size();k++ )
+		{
+			// every dependency is on an earlier level, so its status is final
+			size_t i = (size_t)level[k];
+			if ( !NeedsEvaluation( i, plan ) ) continue;
+
+			// equations writing a variable already written within the
+			// batch stay on this thread, after the batch
+			bool parallel = m_parallel[i] != 0;
+			const std::vector<SymbolId> &out = m_eqns[i]->output_ids;
+			for( size_t j=0;parallel && j<out.size();j++ )
+				if ( written.Get( out[j] ) )
+					parallel = false;
+
+			if ( parallel )
 			{
-				int idx = m_efl.GetEquationIndex( inputs[j] );
-				if ( idx >= 0 && idx < (int)m_status.size() 
-					&& m_status[idx] == INVALID )
-				{
-					// if an equation was found for an input and it has not yet evaluated,
-					// we cannot yet evaluate this equation
-						can_eval = false;
-				}
+				for( size_t j=0;j<out.size();j++ )
+					written.At( out[j] ) = 1;
+				batch.push_back( i );
 			}
+			else
+				serial.push_back( i );
+		}
 
-			if (can_eval)
-			{
-				// setup the LK environment
-				bool eval_ok = true;
-				
-				lk::env_t env;
+		if ( batch.size() < m_minBatch )
+		{
+			serial.insert( serial.begin(), batch.begin(), batch.end() );
+			batch.clear();
+		}
 
-				// setup any functions here
-				SetupEnvironment( env );
+		if ( batch.size() > 0 )
+		{
+			// outputs inherited from a base table are copied into this table
+			// before the batch starts, so the workers only ever look names up
+			batch_eqns.clear();
+			saved.resize( batch.size() );
+			for( size_t k=0;k<batch.size();k++ )
+			{
+				EqnData *eqn = m_eqns[ batch[k] ];
+				for( size_t j=0;j<eqn->outputs.size();j++ )
+					m_vars.GetWritable( eqn->outputs[j] );
+				batch_eqns.push_back( eqn );
 
-				VarTableScriptInterpreter e( cur_eqn->tree, &env, &m_vars );
-			
-#ifdef _DEBUG
-				wxLogStatus( "solving... [" + wxJoin(cur_eqn->outputs, ',') 
-					+ "] = f( " + wxJoin(cur_eqn->inputs, ',') + " )" );
-#endif
+				if ( m_cutoff )
+					SaveOutputs( batch[k], saved[k] );
+			}
 
-				// execute the parse tree, check for errors
-				if ( !e.run() )
+			if ( pool.Run( batch_eqns, m_vars, m_parallelEnv, m_compiled, m_vm, ok, errors ) )
+			{
+				for( size_t k=0;k<batch.size();k++ )
 				{
-					for ( size_t m=0;m<e.error_count();m++ )
-						m_errors.Add( "equation engine: " + e.get_error(m) );
-
-					eval_ok = false;
-				}
+					for( size_t m=0;m<errors[k].size();m++ )
+						m_errors.Add( errors[k][m] );
 
-				// evaluate multiple input/output expression
-				if ( eval_ok ) 
-				{
-					// mark this equation as evaluated
-					m_status[i] = OK;
-					nevals++;
-
-					// for equations with a single output (not MIMOs)
-					// the result of expression evaluation is
-					// the value of the single output variable 
-					// (i.e. via the 'return' statement)
-					if ( cur_eqn->result_is_output && cur_eqn->outputs.size() == 1 )
-						e.special_set( cur_eqn->outputs[0], e.result().deref() );
-
-					// all inputs and outputs have been set
-					// mark all outputs as calculated also (so we don't 
-					// re-run the MIMO equation for each output
-					wxArrayString &out = cur_eqn->outputs;
-					for (size_t j=0;j<out.Count();j++)
+					if ( ok[k] )
 					{
-						m_updated.Add( out[j] );
-						
-						int idx = m_efl.GetEquationIndex( out[j] );
-						if ( idx >= 0 && idx < (int)m_status.size() )
-						{
-							// mark equation as evaluated
-							m_status[idx] = OK;
-							ncalculated++;
-							std::vector<size_t>::iterator it = std::find( remaining.begin(), remaining.end(), (size_t)idx );
-							if ( it != remaining.end() )
-								remaining.erase( it );
-						}
+						MarkEvaluated( batch[k], !m_cutoff || OutputsChanged( batch[k], saved[k] ) );
+						nevals++;
 					}
 				}
-				else
-				{
-					m_errors.Add( "fail: [" + wxJoin(cur_eqn->outputs, ',') 
-						+ "] = f( " + wxJoin(cur_eqn->inputs, ',') + " )" );
-				}			
-			} // can eval?
+			}
+			else // another evaluator has the pool
+				serial.insert( serial.begin(), batch.begin(), batch.end() );
+		}
+
+		for( size_t k=0;k<serial.size();k++ )
+			if ( m_status[ serial[k] ] == INVALID && Evaluate( serial[k] ) )
+				nevals++;
+	}
+
+	return (int)nevals;
+}
+
+bool EqnEvaluator::NeedsEvaluation( size_t i, const EqnFastLookup::Plan &plan )
+{
+	// skip equations that are up to date
+	if ( i >= m_status.size() || m_status[i] == OK )
+		return false;
 
-		}// for each equation in the list
+	// the equations this one depends on are all settled by now.  an input
+	// whose equation failed keeps this one from evaluating
+	bool changed = false;
+	const std::vector<int> &deps = plan.deps[i];
+	for( size_t j=0;j<deps.size();j++ )
+	{
+		if ( deps[j] >= (int)m_status.size() ) continue;
 
-		if ( ncalculated == 0 && remaining.size() > 0 )
+		if ( m_status[ deps[j] ] != OK )
 		{
-			m_errors.Add( "no variables calculated in a single iteration, cannot make progress!" );
-			for (size_t i=0;i<remaining.size();i++)
-			{
-				EqnData *eqn = m_eqns[ remaining[i] ];
-				m_errors.Add("eqn not evaluated: [" + wxJoin(eqn->outputs, ',') + "] = f( " + wxJoin(eqn->inputs,',') + ")");
-			}
-		
-			return -1;
+			m_status[i] = INVALID;
+			return false;
 		}
+
+		if ( m_changed[ deps[j] ] )
+			changed = true;
 	}
-	while ( remaining.size() > 0 && ncalculated > 0);
 
-	return nevals;
+	// an equation that is only downstream of a change is up to
+	// date if none of the equations it reads changed their outputs
+	if ( m_status[i] == STALE )
+	{
+		m_status[i] = changed ? INVALID : OK;
+		return changed;
+	}
+
+	return true;
+}
+
+bool EqnEvaluator::Evaluate( size_t i )
+{
+	// functions are registered once per evaluator, and each equation runs
+	// in its own scope below them so no variables carry over between equations
+	if ( !m_envReady )
+	{
+		SetupEnvironment( m_env );
+		m_envReady = true;
+	}
+
+	std::vector<VarValue> saved;
+	if ( m_cutoff )
+		SaveOutputs( i, saved );
+
+	// anything the equation assigned above its own scope is dropped
+	// before the next one runs
+	bool run_ok = RunEquation( m_eqns[i], m_vars, m_env, m_vm, m_errors, m_compiled );
+	m_env.clear_vars();
+	if ( !run_ok )
+		return false;
+
+	MarkEvaluated( i, !m_cutoff || OutputsChanged( i, saved ) );
+	return true;
 }
 
-size_t EqnEvaluator::MarkAffectedEquations( const wxString &var, EqnFastLookup::eqnmark_hash_t &marked )
+void EqnEvaluator::SaveOutputs( size_t i, std::vector<VarValue> &saved )
 {
-	wxArrayString affected;
-	int naffected = m_efl.GetAffectedVariables( var, affected, marked );	
-	if ( naffected == 0 ) return 0;
+	// copies share array storage, so this is cheap until an output is rewritten
+	wxArrayString &out = m_eqns[i]->outputs;
+	saved.assign( out.size(), VarValue() );
+	for( size_t j=0;j<out.size();j++ )
+		if ( VarValue *vv = m_vars.Get( out[j] ) )
+			saved[j] = *vv;
+}
 
-	for (size_t i=0;i<affected.size();i++)
+bool EqnEvaluator::OutputsChanged( size_t i, std::vector<VarValue> &saved )
+{
+	wxArrayString &out = m_eqns[i]->outputs;
+	for( size_t j=0;j<out.size() && j<saved.size();j++ )
 	{
-		int index = m_efl.GetEquationIndex( affected[i] );
-		if ( index >= 0 && index < (int)m_status.size() )
-			m_status[ index ] = INVALID;
+		VarValue *vv = m_vars.Get( out[j] );
+		if ( vv == 0 ? saved[j].Type() != VV_INVALID : !vv->Identical( saved[j] ) )
+			return true;
+	}
 
-		marked[ affected[i] ] = true;
+	return false;
+}
 
-		naffected += MarkAffectedEquations( affected[i], marked );
+void EqnEvaluator::MarkEvaluated( size_t i, bool changed )
+{
+	EqnData *cur_eqn = m_eqns[i];
+
+	// mark this equation as evaluated
+	m_status[i] = OK;
+	if ( changed ) m_changed[i] = 1;
+
+	// all inputs and outputs have been set
+	// mark all outputs as calculated also (so we don't 
+	// re-run the MIMO equation for each output
+	wxArrayString &out = cur_eqn->outputs;
+	for (size_t j=0;j<out.Count();j++)
+	{
+		m_updated.Add( out[j] );
+		
+		int idx = m_efl.GetEquationIndex( cur_eqn->output_ids[j] );
+		if ( idx >= 0 && idx < (int)m_status.size() )
+		{
+			m_status[idx] = OK;
+			if ( changed ) m_changed[idx] = 1;
+		}
 	}
-	return naffected;
 }
 
 int EqnEvaluator::Changed( const wxArrayString &vars )
@@ -550,16 +1156,51 @@ int EqnEvaluator::Changed( const wxArrayString &vars )
 	
 //	wxLogStatus(" Marking equations... %d triggers", (int)vars.size() );
 
-	// recursively mark all affected equations by this variable as INVALID
-	EqnFastLookup::eqnmark_hash_t marked;
+	// the equations reading these variables must be evaluated, and
+	// everything downstream of them is STALE: evaluated only if some
+	// equation it reads actually changes its outputs
+	const EqnFastLookup::Plan &plan = m_efl.GetPlan();
+	std::vector<int> pending;
 	size_t naffected = 0;
 	for( size_t i=0;i<vars.size();i++ )
-		naffected += MarkAffectedEquations( vars[i], marked );
+	{
+		EqnFastLookup::eqnlist_hash_t::const_iterator it = plan.readers.find( vars[i] );
+		if ( it == plan.readers.end() ) continue;
+
+		const std::vector<int> &readers = it->second;
+		for( size_t j=0;j<readers.size();j++ )
+		{
+			int idx = readers[j];
+			if ( idx >= (int)m_status.size() || m_status[idx] == INVALID )
+				continue;
+
+			m_status[idx] = INVALID;
+			naffected++;
+
+			const std::vector<int> &users = plan.users[idx];
+			pending.insert( pending.end(), users.begin(), users.end() );
+		}
+	}
+
+	while( pending.size() > 0 )
+	{
+		int idx = pending.back();
+		pending.pop_back();
+		if ( idx >= (int)m_status.size() || m_status[idx] != OK )
+			continue;
+
+		m_status[idx] = STALE;
+		naffected++;
+
+		const std::vector<int> &users = plan.users[idx];
+		pending.insert( pending.end(), users.begin(), users.end() );
+	}
 
 	if (naffected == 0) return 0;
 
 //	wxLogStatus(" %d affected variables marked.", (int)naffected );
 	
+	m_cutoff = true;
 	return Calculate( );
 }
 
@@ -569,5 +1210,12 @@ void EqnEvaluator::SetupEnvironment( lk::env_t &env )
 	env.register_funcs( lk::stdlib_sysio() );
 	env.register_funcs( lk::stdlib_math() );
 	env.register_funcs( lk::stdlib_string() );
-	env.register_funcs( lk::stdlib_wxui() );
+	if ( wxThread::IsMain() )
+		env.register_funcs( lk::stdlib_wxui() );
+}
+
+void EqnEvaluator::SetupParallelEnvironment( lk::env_t &env )
+{
+	env.register_funcs( lk::stdlib_math() );
+	env.register_funcs( lk::stdlib_string() );
 }
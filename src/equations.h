@@ -24,22 +24,29 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define __equations_h
 
 #include <vector>
+#include <atomic>
 
 #include <wx/string.h>
 #include <wx/arrstr.h>
 #include <wx/stream.h>
+#include <wx/thread.h>
 
 #include <lk/absyn.h>
 #include <lk/lex.h>
 #include <lk/env.h>
+#include <lk/codegen.h>
 
 #include "object.h"
 #include "variables.h"
+#include "symbols.h"
 
 
 struct EqnData
 {
 	lk::node_t *tree; wxArrayString inputs, outputs; bool result_is_output;
+	std::vector<SymbolId> input_ids, output_ids; // interned inputs and outputs
+	lk::bytecode *code; // compiled when loaded, null if the tree must be interpreted
+	wxArrayString calls; // functions called, empty names for calls made through expressions
 };
 
 typedef unordered_map< wxString, wxArrayString*, wxStringHash, wxStringEqual > arraystring_hash_t;
@@ -67,7 +74,8 @@ private:
 	std::vector<EqnData*> m_equations;
 
 	void ScanParseTree( lk::node_t *root, wxArrayString *inputs, wxArrayString *outputs, bool in_assign_lhs = false );
-	bool AddEquation( const wxArrayString &inputs, const wxArrayString &outputs, lk::node_t *tree, bool result_is_output );
+	bool AddEquation( const wxArrayString &inputs, const wxArrayString &outputs, lk::node_t *tree, bool result_is_output, lk::bytecode *code = 0 );
+	lk::bytecode *Compile( lk::expr_t *func );
 
 };
 
@@ -78,6 +86,7 @@ public:
 	
 	typedef unordered_map< wxString, EqnData*, wxStringHash, wxStringEqual > eqndata_hash_t;
 	typedef unordered_map< wxString, size_t, wxStringHash, wxStringEqual > eqnindex_hash_t;
+	typedef unordered_map< wxString, std::vector<int>, wxStringHash, wxStringEqual > eqnlist_hash_t;
 	typedef unordered_map< wxString, bool, wxStringHash, wxStringEqual > eqnmark_hash_t;
 
 	EqnFastLookup();
@@ -94,33 +103,77 @@ public:
 	std::vector<EqnData*> GetEquations() { return m_eqnList; }
 	EqnData *GetEquationData( const wxString &var );
 	int GetEquationIndex( const wxString &var );
+	int GetEquationIndex( SymbolId var ) { return m_eqnIndexById.Get( var ); }
+
+	// the equations compiled into an order where each one follows the
+	// equations that compute its inputs.  built once after equations are
+	// added, so configurations should call Compile() when they are loaded.
+	// simulations prepare on worker threads, so compiling is locked
+	struct Plan
+	{
+		std::vector<int> order; // acyclic equations in evaluation order
+		std::vector< std::vector<int> > levels; // order grouped by depth, no dependencies within a group
+		std::vector<int> cyclic; // equations on or downstream of a cycle
+		std::vector< std::vector<int> > deps; // equations computing each one's inputs
+		std::vector< std::vector<int> > users; // equations reading each one's outputs
+		eqnlist_hash_t readers; // equations reading each variable, by name as Changed() receives them
+	};
+
+	void Compile();
+	const Plan &GetPlan();
 
 private:
 	
+	Plan m_plan;
+	std::atomic<bool> m_planOk;
+	wxMutex m_planLock;
+	void CompilePlan();
+
 	std::vector<EqnData*> m_eqnList;
 	eqndata_hash_t m_eqnLookup;
 	eqnindex_hash_t m_eqnIndices;	
+	SymbolMap<int> m_eqnIndexById;
 };
 
 
+class EqnVM;
+
 class EqnEvaluator
 {
 protected:
 	static const int INVALID = 0;
 	static const int OK = 1;
+	static const int STALE = 2; // downstream of a change, evaluated only if an input changes
 
 
 	VarTable &m_vars;
 	EqnFastLookup &m_efl;
 	std::vector<EqnData*> m_eqns;
 	std::vector<char> m_status;
+	std::vector<char> m_changed; // equations whose outputs changed in this calculation
+	bool m_cutoff; // compare outputs to stop at equations that changed nothing
 	wxArrayString m_errors;
 	wxArrayString m_updated;
+	lk::env_t m_env; // function table shared by all equations
+	bool m_envReady;
+	EqnVM *m_vm; // runs compiled equations, created on first use
+	bool m_compiled;
+	int m_threads;
+	size_t m_minBatch;
+	lk::env_t m_parallelEnv; // function table for equations evaluated on worker threads
+	bool m_parallelReady;
+	std::vector<char> m_parallel; // equations calling only thread safe functions
 	int Calculate( );
-	size_t MarkAffectedEquations( const wxString &var, EqnFastLookup::eqnmark_hash_t &affected );
+	int CalculateLevels( );
+	bool NeedsEvaluation( size_t i, const EqnFastLookup::Plan &plan );
+	bool Evaluate( size_t i );
+	void MarkEvaluated( size_t i, bool changed = true );
+	void SaveOutputs( size_t i, std::vector<VarValue> &saved );
+	bool OutputsChanged( size_t i, std::vector<VarValue> &saved );
 
 public:
 	EqnEvaluator( VarTable &vars, EqnFastLookup &efl );
+	virtual ~EqnEvaluator();
 
 	void Reset();
 	virtual int CalculateAll();
@@ -128,8 +181,29 @@ public:
 	wxArrayString &GetErrors() { return m_errors; }
 	wxArrayString &GetUpdated() { return m_updated; }
 
+	// run equations compiled when they were loaded on the vm (the default),
+	// or interpret every parse tree, e.g. to compare the two
+	void SetCompiled( bool b ) { m_compiled = b; }
+
+	// evaluate independent equations of a dependency level on
+	// this many threads.  one (the default) evaluates serially.  the
+	// worker threads are shared by all evaluators and started once,
+	// sized by the first evaluator to use them
+	void SetThreads( int n ) { m_threads = n; }
+
+	// levels with fewer independent equations than this are evaluated
+	// on the calling thread.  8 is a starting point, not a measurement
+	void SetMinBatch( size_t n ) { m_minBatch = n; }
+
+	// stops the worker threads, called when the application exits
+	static void StopThreads();
+
 	// setup any context-specific function calls here
 	virtual void SetupEnvironment( lk::env_t &env );
+
+	// functions that equations may call from worker threads.  equations
+	// calling anything else are always evaluated on the calling thread
+	virtual void SetupParallelEnvironment( lk::env_t &env );
 };
 
 
@@ -295,7 +295,7 @@ static const char *s_monthNames[12] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun"
 		if (yvars[i]->Type() == VV_ARRAY)
 		{
 			size_t n = 0;
-			double *p = yvars[i]->Array(&n);
+			const double *p = yvars[i]->Array(&n);
 
 			plotdata[i].reserve(ndata);
 			for (size_t k = 0; k < n; k++)
@@ -378,7 +378,7 @@ static const char *s_monthNames[12] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun"
 					// Assume col[0] contains x values in order
 					// assume row[0] contains y values in order
 					size_t nx, ny;
-					double *data = vv->Matrix(&nx, &ny);
+					const double *data = vv->Matrix(&nx, &ny);
 					XX.Resize(nx - 1, ny - 1);
 					YY.Resize(nx - 1, ny - 1);
 					ZZ.Resize(nx - 1, ny - 1);
@@ -604,7 +604,7 @@ int GraphCtrl::Display(std::vector<Simulation *>sims, Graph &gi)
 		if (yvars[i]->Type() == VV_ARRAY)
 		{
 			size_t n = 0;
-			double *p = yvars[i]->Array(&n);
+			const double *p = yvars[i]->Array(&n);
 
 			plotdata[i].reserve(ndata);
 			for (size_t k = 0; k < n; k++)
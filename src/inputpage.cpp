@@ -594,8 +594,8 @@ bool ActiveInputPage::DataExchange( wxUIObject *obj, VarValue &val, DdxDir dir )
 			double *p;
 			if (dir == VAR_TO_OBJ)
 			{
-				p = val.Matrix( &nr, &nc );
-				dp->SetData(p, nr, nc );
+				// the control copies the data
+				dp->SetData( const_cast<double*>( val.Matrix( &nr, &nc ) ), nr, nc );
 			}
 			else
 			{
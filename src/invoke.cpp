@@ -1644,8 +1644,9 @@ void fcall_ssc_exec( lk::invoke_t &cxt )
 	}
 
 
+	// there is no window to show progress in when running headless
 	wxThreadProgressDialog *tpd = 0;
-	if ( show_dialog )
+	if ( show_dialog && !SamApp::IsHeadless() )
 	{
 		tpd = new wxThreadProgressDialog( SamApp::Window(), 1, true );
 		tpd->CenterOnParent();
@@ -4432,7 +4433,7 @@ void fcall_parametric_get(lk::invoke_t &cxt)
 	else if (vv->Type() == VV_ARRAY) {
 		size_t n = 0;
 		for (size_t i = start; i < end; i++) {
-			double* val = sims[i]->GetValue(cxt.arg(0).as_string())->Array(&n);
+			const double* val = sims[i]->GetValue(cxt.arg(0).as_string())->Array(&n);
 			lk::vardata_t* row = nullptr;
 			if (singleVal > -1) {
 				out.empty_vector();
@@ -4452,7 +4453,7 @@ void fcall_parametric_get(lk::invoke_t &cxt)
 		size_t nr = 0;
 		size_t nc = 0;
 		for (size_t i = start; i < end; i++) {
-			double* val = sims[i]->GetValue(cxt.arg(0).as_string())->Matrix(&nr, &nc);
+			const double* val = sims[i]->GetValue(cxt.arg(0).as_string())->Matrix(&nr, &nc);
 			lk::vardata_t* rows = nullptr;
 			if (singleVal > -1) {
 				out.empty_vector();
@@ -4568,14 +4569,14 @@ static void fcall_reopt_size_battery(lk::invoke_t &cxt)
                         break;
                     case VV_ARRAY:{
                         size_t n;
-                        double* arr = vd->Array(&n);
-                        ssc_data_set_array(p_data, i.c_str(), arr, n);
+                        const double* arr = vd->Array(&n);
+                        ssc_data_set_array(p_data, i.c_str(), const_cast<double*>(arr), n); // ssc copies the data
                         break;
                     }
                     case VV_MATRIX:{
                         size_t n, m;
-                        double* mat = vd->Matrix(&n, &m);
-                        ssc_data_set_matrix(p_data, i.c_str(), mat, n, m);
+                        const double* mat = vd->Matrix(&n, &m);
+                        ssc_data_set_matrix(p_data, i.c_str(), const_cast<double*>(mat), n, m); // ssc copies the data
                         break;
                     }
                     default:
@@ -4916,6 +4917,21 @@ lk::fcall_t* invoke_equation_funcs()
 	return (lk::fcall_t*)vec;
 }
 
+// the equation functions that neither open dialogs nor use the main
+// window, so they can be registered for equations run off the main thread
+lk::fcall_t* invoke_equation_thread_funcs()
+{
+	static const lk::fcall_t vec[] = {
+		fcall_substance_density,
+		fcall_substance_userhtf,
+		fcall_substance_specific_heat,
+		fcall_snlinverter,
+		fcall_current_at_voltage_cec,
+		fcall_current_at_voltage_sandia,
+		0 };
+	return (lk::fcall_t*)vec;
+}
+
 lk::fcall_t* invoke_casecallback_funcs()
 {
 	static const lk::fcall_t vec[] = {
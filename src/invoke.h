@@ -56,6 +56,7 @@ lk::fcall_t* invoke_lossdiag_funcs();
 
 // functions that can be called in equations
 lk::fcall_t* invoke_equation_funcs(); 
+lk::fcall_t* invoke_equation_thread_funcs();
 
 
 
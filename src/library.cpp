@@ -302,6 +302,7 @@ int Library::GetFieldIndex( const wxString &name )
 
 int Library::FindEntry( const wxString &name )
 {
+	wxMutexLocker _lock( m_csvLock );
 	size_t r = m_csv.NumRows();
 	for( size_t i=m_startRow;i<r;i++ )
 		if (name.IsSameAs(m_csv(i, 0), caseSensitiveFind))
@@ -323,17 +324,25 @@ wxString Library::GetEntryName( int entry )
 bool Library::ApplyEntry( int entry, int varindex, VarTable &tab, wxArrayString &changed )
 {
 	m_errors.Clear();
+	return ApplyEntry( entry, varindex, tab, changed, m_errors );
+}
+
+bool Library::ApplyEntry( int entry, int varindex, VarTable &tab, wxArrayString &changed, wxArrayString &errors )
+{
+	size_t nerrors = errors.Count();
 
 	if ( varindex < 0 || varindex >= (int)m_startRow-2 )
 	{
-		m_errors.Add( wxString::Format("invalid varindex of %d", varindex ) );
+		errors.Add( wxString::Format("invalid varindex of %d", varindex ) );
 		return false;
 	}
 	
+	wxMutexLocker _lock( m_csvLock );
+
 	size_t row = m_startRow + (size_t)entry;
 	if ( row >= m_csv.NumRows() || row < m_startRow )
 	{
-		m_errors.Add( wxString::Format("invalid entry %d (max %d)", entry, (int)(m_csv.NumRows()-m_startRow)) );
+		errors.Add( wxString::Format("invalid entry %d (max %d)", entry, (int)(m_csv.NumRows()-m_startRow)) );
 		return false;
 	}
 
@@ -347,18 +356,18 @@ bool Library::ApplyEntry( int entry, int varindex, VarTable &tab, wxArrayString
 
 		if ( var.IsEmpty() ) continue; // skip this variable if no name was found
 
-		if ( VarValue *vv = tab.Get( var ) )
+		if ( VarValue *vv = tab.GetWritable( var ) )
 		{
 			if( VarValue::Parse( vv->Type(), m_csv(row,f.DataIndex), *vv ) )
 				changed.Add( var );
 			else
-				m_errors.Add( "could not parse '" + var + "' to required data type" );
+				errors.Add( "could not parse '" + var + "' to required data type" );
 		}
 		else
-			m_errors.Add( "variable '" + var + "' not found in collection" );		
+			errors.Add( "variable '" + var + "' not found in collection" );		
 	}
 
-	return m_errors.Count() == 0;
+	return errors.Count() == nerrors;
 }
 
 
@@ -26,6 +26,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <wx/string.h>
 #include <wx/listctrl.h>
 #include <wx/panel.h>
+#include <wx/thread.h>
 
 #include <wex/csv.h>
 
@@ -75,9 +76,12 @@ public:
 	wxString GetEntryValue( int entry, int field );
 	wxString GetEntryName( int entry );
 	bool ApplyEntry( int entry, int varindex, VarTable &tab, wxArrayString &changed );
+	// thread-safe version: errors are returned to the caller rather than saved in the library
+	bool ApplyEntry( int entry, int varindex, VarTable &tab, wxArrayString &changed, wxArrayString &errors );
 
 private:
 	wxCSVData m_csv;
+	wxMutex m_csvLock; // entries may be looked up from simulation worker threads
 
 	bool ScanData();
 
@@ -39,7 +39,8 @@ public:
 		// constant is a power of two: so use bitwise operator for better performance
 		// see https://en.wikipedia.org/wiki/Modulo_operation#Performance_issues 
 		if ( 0 == (m_counter++ & 1023) ) {
-			wxGetApp().Yield( true );
+			if ( !SamApp::IsHeadless() )
+				wxGetApp().Yield( true );
 			return !m_me->IsStopFlagSet();
 		}
 		else return true;
@@ -53,7 +54,8 @@ public:
 	my_vm( MacroEngine *me ) : m_me(me) { }
 	virtual bool on_run( const lk::srcpos_t & )
 	{
-		wxGetApp().Yield( true );
+		if ( !SamApp::IsHeadless() )
+			wxGetApp().Yield( true );
 		return !m_me->IsStopFlagSet();
 	}
 };
@@ -107,6 +107,7 @@
 #include "casewin.h"
 #include "invoke.h"
 #include "library.h"
+#include "simcache.h"
 #include "uiobjects.h"
 #include "variablegrid.h"
 #include "script.h"
@@ -199,6 +200,8 @@ static SamApp::ver releases[] = {
 
 static wxArrayString g_appArgs;
 static MainWindow *g_mainWindow = 0;
+static bool g_headless = false;
+static ProjectFile g_headlessProject;
 static wxConfig *g_config = 0;
 static ConfigDatabase g_cfgDatabase;
 static InputPageDatabase g_uiDatabase;
@@ -1869,6 +1872,9 @@ void ConfigDatabase::RebuildCaches()
 
 			CachePagesInConfiguration( igrp->ExclusiveHeaderPages, ci );
 		}
+
+		// order the equations once here rather than on the first evaluation
+		ci->Equations.Compile();
 	}
 }
 
@@ -2100,6 +2106,35 @@ extern void RegisterReportObjectTypes();
     return true;
 }
 
+bool SamApp::InitHeadless( const wxArrayString &args )
+{
+	g_headless = true;
+
+	ObjectTypes::Register( new StringHash );
+	ObjectTypes::Register( new Case );
+
+	// input page definitions are still needed for variables and equations
+	wxUIObjectTypeProvider::RegisterBuiltinTypes();
+	RegisterUIObjectsForSAM();
+
+	g_appArgs = args;
+	if ( g_appArgs.Count() < 1 || !wxDirExists( wxPathOnly(g_appArgs[0]) ) )
+	{
+		wxLogError( "cannot determine application runtime folder from startup argument" );
+		return false;
+	}
+
+	g_config = new wxConfig( "SystemAdvisorModel", "NREL" );
+
+	Restart();
+	return true;
+}
+
+bool SamApp::IsHeadless()
+{
+	return g_headless;
+}
+
 void SamApp::OnFatalException()
 {
 #ifdef __WXMSW__
@@ -2158,6 +2193,7 @@ int SamApp::OnExit()
 
 
 	wxEasyCurl::Shutdown();
+	EqnEvaluator::StopThreads();
 
 	wxLog::SetActiveTarget( 0 );
 	return 0;
@@ -2213,7 +2249,12 @@ void SamApp::Restart()
 	wxLogStatus("loading startup script: " + startup_script );
 	wxArrayString errors;
 	if ( !LoadAndRunScriptFile( startup_script, &errors ) )
-		wxShowTextMessageDialog( "error during startup:\n\n" + wxJoin( errors, '\n' ) );
+	{
+		if ( g_headless )
+			wxLogError( "error during startup:\n\n" + wxJoin( errors, '\n' ) );
+		else
+			wxShowTextMessageDialog( "error during startup:\n\n" + wxJoin( errors, '\n' ) );
+	}
 
 
 	wxLogStatus("rebuilding caches for each configuration's variables and equations");
@@ -2239,6 +2280,8 @@ void SamApp::Restart()
 	}
 
 
+	SimulationCache::Global().LoadSettings();
+
 	g_globalCallbacks.ClearAll();
 	if ( !g_globalCallbacks.LoadFile( SamApp::GetRuntimePath() + "/metrics.lk" ))
 	  {
@@ -2331,6 +2374,8 @@ MainWindow *SamApp::Window()
 
 ProjectFile &SamApp::Project()
 {
+	// there is no main window when running headless
+	if ( g_headless ) return g_headlessProject;
 	return g_mainWindow->Project();
 }
 
@@ -3244,4 +3289,17 @@ bool ShowConfigurationDialog( wxWindow *parent, wxString *tech, wxString *fin, b
 }
 
 
+#ifdef SAM_HEADLESS
+// the batch runner (batch.cpp) provides its own console application object.
+// interactive code checks SamApp::IsHeadless() before getting here, so reaching
+// this without a SamApp is a bug: stop rather than use the wrong object
+SamApp &wxGetApp()
+{
+	SamApp *app = dynamic_cast<SamApp*>( wxAppConsole::GetInstance() );
+	if ( !app )
+		wxLogFatalError( "interactive SAM code was called from the headless batch runner" );
+	return *app;
+}
+#else
 IMPLEMENT_APP( SamApp );
+#endif
@@ -318,6 +318,11 @@ public:
 	virtual int OnExit();
 	virtual void OnFatalException();
 
+	// set up the runtime without any user interface, for the batch runner.
+	// args[0] must be the path to the executable
+	static bool InitHeadless( const wxArrayString &args );
+	static bool IsHeadless();
+
 	static void Restart();
 	static wxString ReadProxyFile();
 	static bool WriteProxyFile( const wxString & );
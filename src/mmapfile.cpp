@@ -0,0 +1,166 @@
+/**
+BSD-3-Clause
+Copyright 2019 Alliance for Sustainable Energy, LLC
+Redistribution and use in source and binary forms, with or without modification, are permitted provided
+that the following conditions are met :
+1.	Redistributions of source code must retain the above copyright notice, this list of conditions
+and the following disclaimer.
+2.	Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+and the following disclaimer in the documentation and/or other materials provided with the distribution.
+3.	Neither the name of the copyright holder nor the names of its contributors may be used to endorse
+or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER, CONTRIBUTORS, UNITED STATES GOVERNMENT OR UNITED STATES
+DEPARTMENT OF ENERGY, NOR ANY OF THEIR EMPLOYEES, BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+OR CONSEQUENTIAL DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstring>
+
+#include <wx/ffile.h>
+
+#ifdef __WXMSW__
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "mmapfile.h"
+
+MappedFile::MappedFile()
+{
+	m_ok = false;
+	m_mapped = false;
+	m_data = 0;
+	m_size = 0;
+#ifdef __WXMSW__
+	m_file = INVALID_HANDLE_VALUE;
+	m_map = 0;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open( const wxString &file )
+{
+	Close();
+
+#ifdef __WXMSW__
+	HANDLE hfile = ::CreateFileW( file.wc_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL|FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+	if ( hfile != INVALID_HANDLE_VALUE )
+	{
+		LARGE_INTEGER len;
+		if ( ::GetFileSizeEx( hfile, &len ) && len.QuadPart > 0 )
+		{
+			HANDLE hmap = ::CreateFileMappingW( hfile, NULL, PAGE_READONLY, 0, 0, NULL );
+			if ( hmap != NULL )
+			{
+				if ( void *p = ::MapViewOfFile( hmap, FILE_MAP_READ, 0, 0, 0 ) )
+				{
+					m_file = hfile;
+					m_map = hmap;
+					m_data = (const char*)p;
+					m_size = (size_t)len.QuadPart;
+					m_mapped = m_ok = true;
+					return true;
+				}
+				::CloseHandle( hmap );
+			}
+		}
+		::CloseHandle( hfile );
+	}
+#else
+	int fd = ::open( (const char*)file.fn_str(), O_RDONLY );
+	if ( fd >= 0 )
+	{
+		struct stat st;
+		if ( ::fstat( fd, &st ) == 0 && st.st_size > 0 )
+		{
+			void *p = ::mmap( 0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+			if ( p != MAP_FAILED )
+			{
+				// the mapping stays valid once the descriptor is closed
+				::close( fd );
+#ifdef MADV_SEQUENTIAL
+				::madvise( p, (size_t)st.st_size, MADV_SEQUENTIAL );
+#endif
+				m_data = (const char*)p;
+				m_size = (size_t)st.st_size;
+				m_mapped = m_ok = true;
+				return true;
+			}
+		}
+		::close( fd );
+	}
+#endif
+
+	// empty files can't be mapped, and some file systems don't support it,
+	// so fall back to reading the whole file
+	wxFFile ff( file, "rb" );
+	if ( !ff.IsOpened() ) return false;
+
+	wxFileOffset len = ff.Length();
+	if ( len < 0 ) return false;
+
+	m_buf.SetBufSize( (size_t)len + 1 );
+	if ( len > 0 && ff.Read( m_buf.GetWriteBuf( (size_t)len ), (size_t)len ) != (size_t)len )
+		return false;
+
+	m_buf.UngetWriteBuf( (size_t)len );
+	m_data = (const char*)m_buf.GetData();
+	m_size = (size_t)len;
+	m_ok = true;
+	return true;
+}
+
+void MappedFile::Unmap()
+{
+	if ( !m_mapped ) return;
+
+#ifdef __WXMSW__
+	::UnmapViewOfFile( m_data );
+	::CloseHandle( (HANDLE)m_map );
+	::CloseHandle( (HANDLE)m_file );
+	m_file = INVALID_HANDLE_VALUE;
+	m_map = 0;
+#else
+	::munmap( (void*)m_data, m_size );
+#endif
+	m_mapped = false;
+}
+
+void MappedFile::Detach()
+{
+	if ( !m_mapped ) return;
+
+	wxMemoryBuffer buf( m_size + 1 );
+	memcpy( buf.GetWriteBuf( m_size ), m_data, m_size );
+	buf.UngetWriteBuf( m_size );
+	Unmap();
+
+	m_buf = buf;
+	m_data = (const char*)m_buf.GetData();
+}
+
+void MappedFile::Close()
+{
+	Unmap();
+
+	m_buf.Clear();
+	m_ok = false;
+	m_mapped = false;
+	m_data = 0;
+	m_size = 0;
+}
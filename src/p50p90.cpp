@@ -180,6 +180,9 @@ void P50P90Form::OnSimulate( wxCommandEvent & )
 	
 	tpd.NewStage( "Preparing simulations...", 1 );
 	
+	// all years share one copy of the case values
+	std::shared_ptr<VarTable> base_inputs = std::make_shared<VarTable>( m_case->Values() );
+
 	std::vector<Simulation*> sims;
 	for (size_t n=0; n<years.size(); n++)
 	{
@@ -188,13 +191,14 @@ void P50P90Form::OnSimulate( wxCommandEvent & )
 		Simulation *sim = new Simulation( m_case, wxString::Format("Year %d", (int)years[n]) );
 		sims.push_back( sim );
 
+		sim->SetBaseInputs( base_inputs );
 		sim->Override( "use_specific_weather_file", VarValue(true) );
 		sim->Override( "user_specified_weather_file", VarValue(weatherFile) );
 		sim->Override("use_specific_wf_wind", VarValue(true));
 		sim->Override("user_specified_wf_wind", VarValue(weatherFile));
 
-		if ( !sim->Prepare() )
-			wxMessageBox( wxString::Format("internal error preparing simulation %d for P50 / P90", (int)(n+1)) );
+		// only single value outputs are used in the P50/P90 statistics
+		sim->SetOutputFilter( true );
 
 		tpd.Update( 0, (float)n / (float)years.size() * 100.0f, wxString::Format("%d of %d", (int)(n+1), (int)years.size()  ) );
 		
@@ -210,7 +214,7 @@ void P50P90Form::OnSimulate( wxCommandEvent & )
 
 
 	tpd.NewStage( "Calculating..." );
-	size_t nyearsok = Simulation::DispatchThreads( tpd, sims, nthread );
+	size_t nyearsok = Simulation::DispatchThreads( tpd, sims, nthread, true );
 	
 	tpd.NewStage( "Collecting outputs...", 1 );
 	// all single value output data for each run
@@ -1203,7 +1203,7 @@ void ParametricViewer::AddPlot(const wxString &output_name)
 					for (int row = 0; row < m_grid_data->GetRowsCount(); row++)
 					{
 						size_t n;
-						double *y = m_grid_data->GetArray(row, col, &n);
+						const double *y = m_grid_data->GetArray(row, col, &n);
 						size_t steps_per_hour = n/8760;
 						if ( steps_per_hour > 0 
 							&& steps_per_hour <= 60 
@@ -2045,9 +2045,9 @@ std::vector<double> ParametricGridData::GetArray(int row, int col)
 	return ret_val;
 }
 
-double *ParametricGridData::GetArray(int row, int col, size_t *n)
+const double *ParametricGridData::GetArray(int row, int col, size_t *n)
 {
-	double *ret_val = NULL;
+	const double *ret_val = NULL;
 	if (VarValue *vv = GetVarValue(row, col))
 	{
 		if (vv->Type() == VV_ARRAY)
@@ -2183,6 +2183,9 @@ bool ParametricGridData::RunSimulations_multi()
 		if (!m_valid_run[i]) total_runs++;
 	if (total_runs == 0) total_runs = m_par.Runs.size();
 
+	// all runs share one copy of the case values, and only hold their own overrides
+	std::shared_ptr<VarTable> base_inputs = std::make_shared<VarTable>(m_case->Values());
+
 	std::vector<Simulation*> sims;
 	for (size_t i = 0; i < m_par.Runs.size(); i++)
 	{
@@ -2192,6 +2195,7 @@ bool ParametricGridData::RunSimulations_multi()
 		if (!m_valid_run[i])
 		{
 			m_par.Runs[i]->Clear();
+			m_par.Runs[i]->SetBaseInputs(base_inputs);
 
 			for (int col = 0; col < m_cols; col++)
 			{
@@ -2209,9 +2213,6 @@ bool ParametricGridData::RunSimulations_multi()
 			if (ex.Enabled)
 				ExcelExchange::RunExcelExchange(ex, m_case->Values(), m_par.Runs[i]);
 
-			if (!m_par.Runs[i]->Prepare())
-				wxMessageBox(wxString::Format("internal error preparing simulation %d for parametric: %s", (int)(i + 1), m_par.Runs[i]->GetErrors()[0]));
-
 			tpd.Update(0, (float)i / (float)total_runs * 100.0f, wxString::Format("%d of %d", (int)(i + 1), (int)total_runs));
 		}
 
@@ -2226,7 +2227,8 @@ bool ParametricGridData::RunSimulations_multi()
 	if ( nthread > (int)sims.size() ) nthread = sims.size();
 	tpd.NewStage("Calculating...", nthread);
 
-	Simulation::DispatchThreads(tpd, sims, nthread);
+	// each run is prepared by the worker thread that simulates it
+	Simulation::DispatchThreads(tpd, sims, nthread, true);
 
 //	int time_sim = sw.Time();
 	sw.Start();
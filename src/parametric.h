@@ -125,7 +125,7 @@ public:
 
 	double GetDouble(int row, int col);
 	std::vector<double> GetArray(int row, int col);
-	double *GetArray(int row, int col, size_t *n);
+	const double *GetArray(int row, int col, size_t *n);
 	wxString GetUnits(int col);
 
 	void FillDown(int col, int rows=2);
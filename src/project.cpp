@@ -26,6 +26,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <wx/datstrm.h>
 #include <wx/wfstream.h>
 #include <wx/zstream.h>
+#include <wx/mstream.h>
 #include <wx/tokenzr.h>
 
 #include <wx/window.h>
@@ -298,54 +299,27 @@ bool ProjectFile::Read( wxInputStream &input )
 	return (in.Read16() == code );
 }
 
-bool ProjectFile::WriteArchive( const wxString &file )
+// the archive container calls back into the project for its main stream
+class ProjectArchive : public LargeValueArchive
 {
-	wxFFileOutputStream out( file );
-	if ( ! out.IsOk() ) return false;
-
-	// write two bytes of uncompressed identifiers
-	wxUint8 code = 0x41;
-	out.Write( &code, 1 );
-	code = 0xb9;
-	out.Write( &code, 1 );
-
-	// write one byte to indicate compression format
-	// currently only zlib (=1) supported
-	code = 1;
-	out.Write( &code, 1 );
+	ProjectFile &m_pf;
+public:
+	ProjectArchive( ProjectFile &pf ) : m_pf( pf ) { }
+protected:
+	virtual void WriteMain( wxOutputStream &os ) { m_pf.Write( os ); }
+	virtual bool ReadMain( wxInputStream &is ) { return m_pf.Read( is ); }
+};
 
-	wxZlibOutputStream zout( out );
-	Write( zout );
-	return true;
+bool ProjectFile::WriteArchive( const wxString &file )
+{
+	ProjectArchive pa( *this );
+	return pa.WriteArchive( file );
 }
 
 bool ProjectFile::ReadArchive( const wxString &file )
 {
-	wxFFileInputStream in( file );
-	if ( !in.IsOk() ) return false;
-	
-	wxUint8 code1, code2, comp;
-	in.Read( &code1, 1 );
-	in.Read( &code2, 1 );
-
-	if ( code1 != 0x41 || code2 != 0xb9 )
-	{
-		// old format, uncompressed
-		in.Ungetch( code2 );
-		in.Ungetch( code1 );
-		
-		return Read( in );
-	}
-	else
-	{
-		// determine compression format
-		in.Read(&comp, 1);
-		if ( comp != 1 ) // unknown compression type
-			return false;
-
-		wxZlibInputStream zin( in );
-		return Read( zin );
-	}
+	ProjectArchive pa( *this );
+	return pa.ReadArchive( file );
 }
 
 void ProjectFile::SetVersionInfo( int maj, int min, int mic, int patch )
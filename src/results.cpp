@@ -608,7 +608,7 @@ ResultsViewer::~ResultsViewer()
 		delete m_tsDataSets[i];
 }
 
-TimeSeriesData::TimeSeriesData( double *p, size_t len, double ts_hour, double ts_offset, const wxString &label, const wxString &units )
+TimeSeriesData::TimeSeriesData( const double *p, size_t len, double ts_hour, double ts_offset, const wxString &label, const wxString &units )
   	: wxDVTimeSeriesDataSet(), m_pdata(p), m_len(len), m_tsHour(ts_hour), m_label(label), m_units(units), m_startOffsetHours(ts_offset)
 {
 	/* nothing to do */
@@ -830,7 +830,7 @@ void ResultsViewer::Setup( Simulation *sim )
 			if ((vv->Type() == VV_ARRAY) && (!m_sim->GetLabel(vars[i]).IsEmpty()))
 			{
 				size_t n = 0;
-				double *p = vv->Array( &n );
+				const double *p = vv->Array( &n );
 				
 				int steps_per_hour = (int)n / 8760; 
 				if (steps_per_hour * 8760 != (int)n)
@@ -986,7 +986,7 @@ void ResultsViewer::Setup( Simulation *sim )
 				if (VarValue *vv = m_sim->GetValue(cl.name))
 				{
 					double _val = 0.0;
-					double *p = &_val;
+					const double *p = &_val;
 					size_t n = 1;
 
 					if (vv->Type() == VV_ARRAY) p = vv->Array(&n);
@@ -1054,7 +1054,7 @@ void ResultsViewer::Setup( Simulation *sim )
 					if (VarValue *vv = m_sim->GetValue(list[i]))
 					{
 						double _val = 0.0f;
-						double *p = &_val;
+						const double *p = &_val;
 						size_t m = 1;
 
 						if (vv->Type() == VV_ARRAY) p = vv->Array(&n);
@@ -1713,7 +1713,7 @@ public:
 	struct ColData
 	{
 		wxString Label;
-		double * Values;
+		const double * Values;
 		double SingleValue;
 		size_t N;
 	};
@@ -294,13 +294,13 @@ private:
 
 class TimeSeriesData : public wxDVTimeSeriesDataSet
 {
-	double *m_pdata;
+	const double *m_pdata;
 	size_t m_len;
 	double m_tsHour;
 	wxString m_label, m_units;
 	double m_startOffsetHours;
 public:
-	TimeSeriesData( double *p, size_t len, double ts_hour, double ts_offset, const wxString &label, const wxString &units );
+	TimeSeriesData( const double *p, size_t len, double ts_hour, double ts_offset, const wxString &label, const wxString &units );
 	virtual wxRealPoint At(size_t i) const;
 	virtual size_t Length() const { return m_len; }
 	virtual double GetTimeStep() const { return m_tsHour; }
@@ -34,6 +34,8 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "main.h"
 #include "invoke.h"
 #include "simulation.h"
+#include "simcache.h"
+#include "simtrace.h"
 #include "script.h"
 #include "urdb.h"
 
@@ -238,7 +240,8 @@ public:
 
 	virtual void Update( float, const wxString & )
 	{
-		wxGetApp().Yield( true );
+		if ( !SamApp::IsHeadless() )
+			wxGetApp().Yield( true );
 	}
 
 	virtual bool IsCancelled()
@@ -402,7 +405,7 @@ static lkParSimList sg_parSims;
 
 static void fcall_parsim( lk::invoke_t &cxt )
 {
-	LK_DOC( "parsim", "Run a set of simulations in parallel. Options include 'nthreads'.  Returns the number of successful runs.", "( array-of-tables:runs, [table:options] ):number" );
+	LK_DOC( "parsim", "Run a set of simulations in parallel. Options include 'nthreads', and 'outputs' (array of output names to keep, or 'single' to keep only single value outputs).  Returns the number of successful runs.", "( array-of-tables:runs, [table:options] ):number" );
 
 	sg_parSims.delete_sims();
 
@@ -414,10 +417,23 @@ static void fcall_parsim( lk::invoke_t &cxt )
 	}
 
 	int nthreads = wxThread::GetCPUCount();
+	wxArrayString output_filter;
+	bool single_values = false;
 	if ( cxt.arg_count() > 1  && cxt.arg(1).type() == lk::vardata_t::HASH )
 	{
 		if ( lk::vardata_t *x = cxt.arg(1).lookup("nthreads") )
 			nthreads = x->as_integer();
+
+		if ( lk::vardata_t *x = cxt.arg(1).lookup("outputs") )
+		{
+			if ( x->deref().type() == lk::vardata_t::VECTOR )
+			{
+				for( size_t i=0;i<x->deref().length();i++ )
+					output_filter.Add( x->deref().index(i)->as_string() );
+			}
+			else if ( x->as_string().Lower() == "single" )
+				single_values = true;
+		}
 	}
 	
 	lk::vardata_t &runs = cxt.arg(0);
@@ -429,6 +445,9 @@ static void fcall_parsim( lk::invoke_t &cxt )
 	
 	SimulationDialog tpd( "Preparing simulations...", nthreads );
 
+	// all runs share one copy of the case values
+	std::shared_ptr<VarTable> base_inputs = std::make_shared<VarTable>( cc->Values() );
+
 	for( size_t i=0;i<runs.length();i++ )
 	{
 		lk::vardata_t &run = runs.index(i)->deref();
@@ -440,6 +459,8 @@ static void fcall_parsim( lk::invoke_t &cxt )
 
 		Simulation *sim = new Simulation( cc, wxString::Format("run %d", (int)i+1 ) );
 		sg_parSims.push_back( sim );
+		sim->SetOutputFilter( output_filter, single_values );
+		sim->SetBaseInputs( base_inputs );
 
 		for( lk::varhash_t::iterator it = run.hash()->begin();
 			it != run.hash()->end();
@@ -455,12 +476,6 @@ static void fcall_parsim( lk::invoke_t &cxt )
 			sim->Override( name, value );
 		}
 
-		if ( !sim->Prepare() )
-		{
-			cxt.error( wxString::Format("internal error preparing run %d in parsim()", (int)(i+1)) );
-			return;
-		}
-
 		tpd.Update( 0, (float)i / (float)runs.length() * 100.0f, wxString::Format("%d of %d", (int)(i+1), (int)runs.length()  ) );
 		
 		if ( tpd.Canceled() )
@@ -470,7 +485,7 @@ static void fcall_parsim( lk::invoke_t &cxt )
 	if ( nthreads > (int)sg_parSims.size() ) nthreads = sg_parSims.size();
 	tpd.NewStage("Calculating...", nthreads);
 
-	int nok = Simulation::DispatchThreads( tpd, sg_parSims, nthreads );
+	int nok = Simulation::DispatchThreads( tpd, sg_parSims, nthreads, true );
 	cxt.result().assign( (double)nok );
 }
 
@@ -490,11 +505,94 @@ void fcall_parout( lk::invoke_t &cxt )
 		cxt.result().hash_item( "errors", wxJoin(sim.GetErrors(), ';') );
 		cxt.result().hash_item( "warnings", wxJoin(sim.GetWarnings(), ';') );
 		cxt.result().hash_item( "notices", wxJoin(sim.GetNotices(), ';') );
+
+		lk::vardata_t &stages = cxt.result().hash_item( "stages" );
+		stages.empty_hash();
+		std::vector<Simulation::StageTime> &times = sim.GetStageTimes();
+		for( size_t i=0;i<times.size();i++ )
+			stages.hash_item( times[i].name, times[i].msec );
 	}
 	else if ( VarValue *vv = sim.GetValue( cxt.arg(1).as_string() ) )
 		vv->Write( cxt.result() );
 }
 
+static void fcall_simcache( lk::invoke_t &cxt )
+{
+	LK_DOC( "simcache", "Configure the cache of compute module results and return its statistics. Options include 'enable', 'memory_mb', 'disk_mb' (0 disables the disk cache), 'folder', 'clear' (1 for memory, 2 for memory and disk), and 'reset' (statistics).", "( [table:options] ):table" );
+
+	SimulationCache &cache = SimulationCache::Global();
+	if ( cxt.arg_count() > 0 && cxt.arg(0).type() == lk::vardata_t::HASH )
+	{
+		lk::vardata_t &opts = cxt.arg(0);
+		if ( lk::vardata_t *x = opts.lookup("memory_mb") )
+			cache.SetMemoryLimit( (size_t)x->as_unsigned()*1024*1024 );
+		if ( lk::vardata_t *x = opts.lookup("disk_mb") )
+			cache.SetDiskLimit( (size_t)x->as_unsigned()*1024*1024 );
+		if ( lk::vardata_t *x = opts.lookup("folder") )
+			cache.SetDiskFolder( x->as_string() );
+		if ( lk::vardata_t *x = opts.lookup("enable") )
+			cache.Enable( x->as_boolean() );
+		if ( lk::vardata_t *x = opts.lookup("clear") )
+			if ( x->as_integer() > 0 )
+				cache.Clear( x->as_integer() > 1 );
+		if ( lk::vardata_t *x = opts.lookup("reset") )
+			if ( x->as_boolean() )
+				cache.ResetStats();
+
+		cache.SaveSettings();
+	}
+
+	SimulationCache::Stats st = cache.GetStats();
+	cxt.result().empty_hash();
+	cxt.result().hash_item( "enabled", cache.IsEnabled() ? 1.0 : 0.0 );
+	cxt.result().hash_item( "memory_hits", (double)st.memory_hits );
+	cxt.result().hash_item( "disk_hits", (double)st.disk_hits );
+	cxt.result().hash_item( "misses", (double)st.misses );
+	cxt.result().hash_item( "stores", (double)st.stores );
+	cxt.result().hash_item( "evictions", (double)st.evictions );
+	cxt.result().hash_item( "memory_entries", (double)st.memory_entries );
+	cxt.result().hash_item( "memory_mb", st.memory_bytes/1048576.0 );
+	cxt.result().hash_item( "disk_entries", (double)st.disk_entries );
+	cxt.result().hash_item( "disk_mb", st.disk_bytes/1048576.0 );
+	cxt.result().hash_item( "folder", cache.GetDiskFolder() );
+}
+
+static void fcall_simtrace( lk::invoke_t &cxt )
+{
+	LK_DOC( "simtrace", "Control the timing of simulation stages and return total, mean and maximum times in milliseconds for each stage over all runs. Options include 'enable' (record every stage for a trace file), 'clear', and 'file' (write a Chrome/Perfetto trace JSON file).", "( [table:options] ):table" );
+
+	SimulationTrace &trace = SimulationTrace::Global();
+	if ( cxt.arg_count() > 0 && cxt.arg(0).type() == lk::vardata_t::HASH )
+	{
+		lk::vardata_t &opts = cxt.arg(0);
+		if ( lk::vardata_t *x = opts.lookup("file") )
+		{
+			if ( !trace.Write( x->as_string() ) )
+			{
+				cxt.error( "could not write trace file " + x->as_string() );
+				return;
+			}
+		}
+		if ( lk::vardata_t *x = opts.lookup("clear") )
+			if ( x->as_boolean() )
+				trace.Clear();
+		if ( lk::vardata_t *x = opts.lookup("enable") )
+			trace.Enable( x->as_boolean() );
+	}
+
+	std::map<wxString, SimulationTrace::Stat> stats = trace.GetStats();
+	cxt.result().empty_hash();
+	for( std::map<wxString, SimulationTrace::Stat>::iterator it = stats.begin(); it != stats.end(); ++it )
+	{
+		lk::vardata_t &item = cxt.result().hash_item( it->first );
+		item.empty_hash();
+		item.hash_item( "count", (double)it->second.count );
+		item.hash_item( "total", it->second.total_ms );
+		item.hash_item( "mean", it->second.count > 0 ? it->second.total_ms / it->second.count : 0.0 );
+		item.hash_item( "max", it->second.max_ms );
+	}
+}
+
 void fcall_show_page(lk::invoke_t &cxt)
 {
 	LK_DOC("show_page", "Show a specific page in the user interface for the active case", "( string:page name ):boolean");
@@ -591,6 +689,8 @@ lk::fcall_t *sam_functions() {
 		fcall_urdb_list_rates,
 		fcall_parsim,
 		fcall_parout,
+		fcall_simcache,
+		fcall_simtrace,
 		0 };
 	return (lk::fcall_t*)vec;
 
@@ -0,0 +1,647 @@
+/**
+BSD-3-Clause
+Copyright 2019 Alliance for Sustainable Energy, LLC
+Redistribution and use in source and binary forms, with or without modification, are permitted provided
+that the following conditions are met :
+1.	Redistributions of source code must retain the above copyright notice, this list of conditions
+and the following disclaimer.
+2.	Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+and the following disclaimer in the documentation and/or other materials provided with the distribution.
+3.	Neither the name of the copyright holder nor the names of its contributors may be used to endorse
+or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER, CONTRIBUTORS, UNITED STATES GOVERNMENT OR UNITED STATES
+DEPARTMENT OF ENERGY, NOR ANY OF THEIR EMPLOYEES, BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+OR CONSEQUENTIAL DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <wx/dir.h>
+#include <wx/filename.h>
+#include <wx/filefn.h>
+#include <wx/wfstream.h>
+#include <wx/datstrm.h>
+
+#include "simcache.h"
+#include "simulation.h"
+#include "main.h"
+
+static SimulationCache gs_simcache;
+
+// two independent 64 bit lanes give a 128 bit content hash
+class InputHasher
+{
+	wxUint64 m_a, m_b;
+public:
+	InputHasher() : m_a( 14695981039346656037ULL ), m_b( 0x9e3779b97f4a7c15ULL ) { }
+
+	void Bytes( const void *data, size_t n )
+	{
+		const unsigned char *c = (const unsigned char*)data;
+		for( size_t i=0;i<n;i++ )
+		{
+			m_a = (m_a ^ c[i]) * 1099511628211ULL;
+			m_b = (m_b ^ c[i]) * 0xff51afd7ed558ccdULL;
+			m_b ^= m_b >> 29;
+		}
+	}
+
+	void Int( wxUint64 x ) { Bytes( &x, sizeof(x) ); }
+
+	void Str( const char *s )
+	{
+		size_t n = s ? strlen( s ) : 0;
+		Int( n );
+		if ( n > 0 ) Bytes( s, n );
+	}
+
+	wxString Hex()
+	{
+		return wxString::Format( "%016llx%016llx", (unsigned long long)m_a, (unsigned long long)m_b );
+	}
+};
+
+static void hash_var( InputHasher &h, ssc_var_t v );
+
+static void hash_table( InputHasher &h, ssc_data_t t )
+{
+	// ssc does not define an iteration order, so sort the keys
+	std::vector<std::string> keys;
+	const char *key = ssc_data_first( t );
+	while( key )
+	{
+		keys.push_back( key );
+		key = ssc_data_next( t );
+	}
+	std::sort( keys.begin(), keys.end() );
+
+	h.Int( keys.size() );
+	for( size_t i=0;i<keys.size();i++ )
+	{
+		h.Str( keys[i].c_str() );
+		hash_var( h, ssc_data_lookup( t, keys[i].c_str() ) );
+	}
+}
+
+static void hash_var( InputHasher &h, ssc_var_t v )
+{
+	int type = v ? ssc_var_query( v ) : SSC_INVALID;
+	h.Int( type );
+
+	int n = 0, m = 0;
+	ssc_number_t *p = 0;
+	switch( type )
+	{
+	case SSC_NUMBER:
+	{
+		ssc_number_t x = ssc_var_get_number( v );
+		h.Bytes( &x, sizeof(x) );
+		break;
+	}
+	case SSC_STRING:
+	{
+		const char *s = ssc_var_get_string( v );
+		h.Str( s );
+		// inputs that name a file (weather, load data, etc) must
+		// also miss the cache when the file itself changes
+		if ( s != 0 && *s != 0 && strlen( s ) < 1024 && wxFileExists( s ) )
+		{
+			h.Int( (wxUint64) wxFileName::GetSize( s ).GetValue() );
+			h.Int( (wxUint64) wxFileModificationTime( s ) );
+		}
+		break;
+	}
+	case SSC_ARRAY:
+		p = ssc_var_get_array( v, &n );
+		h.Int( n );
+		if ( p && n > 0 ) h.Bytes( p, n*sizeof(ssc_number_t) );
+		break;
+	case SSC_MATRIX:
+		p = ssc_var_get_matrix( v, &n, &m );
+		h.Int( n );
+		h.Int( m );
+		if ( p && n > 0 && m > 0 ) h.Bytes( p, n*m*sizeof(ssc_number_t) );
+		break;
+	case SSC_TABLE:
+		hash_table( h, ssc_var_get_table( v ) );
+		break;
+	case SSC_DATARR:
+		ssc_var_size( v, &n, nullptr );
+		h.Int( n );
+		for( int i=0;i<n;i++ )
+			hash_var( h, ssc_var_get_var_array( v, i ) );
+		break;
+	case SSC_DATMAT:
+		ssc_var_size( v, &n, &m );
+		h.Int( n );
+		h.Int( m );
+		for( int i=0;i<n;i++ )
+			for( int j=0;j<m;j++ )
+				hash_var( h, ssc_var_get_var_matrix( v, i, j ) );
+		break;
+	}
+}
+
+// approximate memory held by a value, used for the memory tier limit
+static size_t value_bytes( VarValue &vv )
+{
+	size_t bytes = sizeof(VarValue);
+	switch( vv.Type() )
+	{
+	case VV_ARRAY:
+		bytes += vv.Length() * sizeof(double);
+		break;
+	case VV_MATRIX:
+		bytes += vv.Rows() * vv.Columns() * sizeof(double);
+		break;
+	case VV_STRING:
+		bytes += vv.String().Len() * sizeof(wxChar);
+		break;
+	case VV_TABLE:
+		for( VarTable::iterator it = vv.Table().begin(); it != vv.Table().end(); ++it )
+			bytes += it->first.Len() * sizeof(wxChar) + value_bytes( *(it->second) );
+		break;
+	case VV_DATARR:
+		for( size_t i=0;i<vv.DataArray().size();i++ )
+			bytes += value_bytes( vv.DataArray()[i] );
+		break;
+	case VV_DATMAT:
+		for( size_t i=0;i<vv.DataMatrix().size();i++ )
+			for( size_t j=0;j<vv.DataMatrix()[i].size();j++ )
+				bytes += value_bytes( vv.DataMatrix()[i][j] );
+		break;
+	}
+	return bytes;
+}
+
+static void write_array_string( wxDataOutputStream &out, wxArrayString &list )
+{
+	out.Write32( list.size() );
+	for( size_t i=0;i<list.size();i++ )
+		out.WriteString( list[i] );
+}
+
+static void read_array_string( wxDataInputStream &in, wxArrayString &list )
+{
+	list.Clear();
+	size_t n = in.Read32();
+	for( size_t i=0;i<n;i++ )
+		list.Add( in.ReadString() );
+}
+
+SimulationCache::SimulationCache()
+{
+	m_enabled = false;
+	m_memLimit = 512*1024*1024UL;
+	m_diskLimit = 0;
+	m_diskScanned = false;
+}
+
+SimulationCache::~SimulationCache()
+{
+	Clear( false );
+}
+
+SimulationCache &SimulationCache::Global()
+{
+	return gs_simcache;
+}
+
+void SimulationCache::LoadSettings()
+{
+	wxConfig &cfg = SamApp::Settings();
+	bool enabled = false;
+	cfg.Read( "SimulationCacheEnabled", &enabled, false );
+	long mem_mb = cfg.ReadLong( "SimulationCacheMemoryMB", 512 );
+	long disk_mb = cfg.ReadLong( "SimulationCacheDiskMB", 0 );
+	wxString folder = cfg.Read( "SimulationCacheFolder", SamApp::GetUserLocalDataDir() + "/simcache" );
+
+	SetMemoryLimit( mem_mb > 0 ? (size_t)mem_mb*1024*1024 : 0 );
+	SetDiskLimit( disk_mb > 0 ? (size_t)disk_mb*1024*1024 : 0 );
+	SetDiskFolder( folder );
+	Enable( enabled );
+}
+
+void SimulationCache::SaveSettings()
+{
+	wxConfig &cfg = SamApp::Settings();
+	cfg.Write( "SimulationCacheEnabled", IsEnabled() );
+	cfg.Write( "SimulationCacheMemoryMB", (long)(GetMemoryLimit()/(1024*1024)) );
+	cfg.Write( "SimulationCacheDiskMB", (long)(GetDiskLimit()/(1024*1024)) );
+	cfg.Write( "SimulationCacheFolder", GetDiskFolder() );
+}
+
+void SimulationCache::Enable( bool b )
+{
+	wxMutexLocker _lock( m_lock );
+	m_enabled = b;
+}
+
+bool SimulationCache::IsEnabled()
+{
+	wxMutexLocker _lock( m_lock );
+	return m_enabled;
+}
+
+void SimulationCache::SetMemoryLimit( size_t bytes )
+{
+	wxMutexLocker _lock( m_lock );
+	m_memLimit = bytes;
+	TrimMemory();
+}
+
+void SimulationCache::SetDiskLimit( size_t bytes )
+{
+	wxMutexLocker _lock( m_lock );
+	m_diskLimit = bytes;
+	if ( m_diskScanned )
+		TrimDisk();
+}
+
+size_t SimulationCache::GetMemoryLimit()
+{
+	wxMutexLocker _lock( m_lock );
+	return m_memLimit;
+}
+
+size_t SimulationCache::GetDiskLimit()
+{
+	wxMutexLocker _lock( m_lock );
+	return m_diskLimit;
+}
+
+void SimulationCache::SetDiskFolder( const wxString &folder )
+{
+	wxMutexLocker _lock( m_lock );
+	if ( folder == m_folder ) return;
+
+	m_folder = folder;
+	m_folder.Replace( "\\", "/" );
+	m_disk.clear();
+	m_diskOrder.clear();
+	m_stats.disk_bytes = 0;
+	m_stats.disk_entries = 0;
+	m_diskScanned = false;
+}
+
+wxString SimulationCache::GetDiskFolder()
+{
+	wxMutexLocker _lock( m_lock );
+	return m_folder;
+}
+
+wxString SimulationCache::Key( ssc_module_t p_mod, const wxString &cmod, ssc_data_t p_data )
+{
+	InputHasher h;
+	h.Str( (const char*)cmod.c_str() );
+
+	// results from a different build of ssc are not reused
+	h.Int( (wxUint64) ssc_version() );
+	h.Str( ssc_build_info() );
+
+	int pidx = 0;
+	while( const ssc_info_t p_inf = ssc_module_var_info( p_mod, pidx++ ) )
+	{
+		int var_type = ssc_info_var_type( p_inf );
+		if ( var_type == SSC_INPUT || var_type == SSC_INOUT )
+		{
+			const char *name = ssc_info_name( p_inf );
+			h.Str( name );
+			hash_var( h, ssc_data_lookup( p_data, name ) );
+		}
+	}
+
+	return cmod + "-" + h.Hex();
+}
+
+void SimulationCache::Restore( Entry *e, ssc_data_t p_data, wxArrayString *warnings, wxArrayString *notices )
+{
+	for( VarTable::iterator it = e->outputs.begin(); it != e->outputs.end(); ++it )
+		VarValueToSSC( it->second, p_data, it->first );
+
+	if ( warnings ) *warnings = e->warnings;
+	if ( notices ) *notices = e->notices;
+}
+
+bool SimulationCache::Lookup( const wxString &key, ssc_data_t p_data, wxArrayString *warnings, wxArrayString *notices )
+{
+	wxString file;
+	entry_ptr e;
+	{
+		wxMutexLocker _lock( m_lock );
+		if ( !m_enabled ) return false;
+
+		auto it = m_mem.find( key );
+		if ( it != m_mem.end() )
+		{
+			// most recently used entries are kept at the front
+			m_memOrder.splice( m_memOrder.begin(), m_memOrder, it->second.pos );
+			e = it->second.entry;
+			m_stats.memory_hits++;
+		}
+		else
+		{
+			if ( !m_folder.IsEmpty() && m_diskLimit > 0 )
+			{
+				if ( !m_diskScanned ) ScanDisk();
+				if ( m_disk.find( key ) != m_disk.end() )
+					file = DiskFile( key );
+			}
+
+			if ( file.IsEmpty() )
+			{
+				m_stats.misses++;
+				return false;
+			}
+		}
+	}
+
+	if ( !e )
+	{
+		// read outside of the lock so other threads aren't held up by disk i/o
+		e.reset( ReadEntry( file ) );
+
+		wxMutexLocker _lock( m_lock );
+		if ( !e )
+		{
+			m_stats.misses++;
+			return false;
+		}
+
+		auto dit = m_disk.find( key );
+		if ( dit != m_disk.end() )
+			m_diskOrder.splice( m_diskOrder.begin(), m_diskOrder, dit->second.pos );
+		wxFileName( file ).Touch();
+
+		m_stats.disk_hits++;
+
+		if ( m_mem.find( key ) == m_mem.end() )
+			AddToMemory( key, e );
+	}
+
+	// entries are never modified once cached, so restoring into the
+	// caller's data container doesn't need the lock
+	Restore( e.get(), p_data, warnings, notices );
+	return true;
+}
+
+void SimulationCache::Store( const wxString &key, ssc_module_t p_mod, ssc_data_t p_data )
+{
+	if ( !IsEnabled() ) return;
+
+	entry_ptr e( new Entry );
+	e->bytes = 0;
+
+	int pidx = 0;
+	while( const ssc_info_t p_inf = ssc_module_var_info( p_mod, pidx++ ) )
+	{
+		int var_type = ssc_info_var_type( p_inf );
+		if ( var_type == SSC_OUTPUT || var_type == SSC_INOUT )
+		{
+			const char *name = ssc_info_name( p_inf );
+			ssc_var_t v = ssc_data_lookup( p_data, name );
+			if ( v && ssc_var_query( v ) != SSC_INVALID )
+			{
+				VarValue *vv = e->outputs.Set( name, VarValue( v ) );
+				e->bytes += strlen( name ) + value_bytes( *vv );
+			}
+		}
+	}
+
+	int type = 0, i = 0;
+	while( const char *text = ssc_module_log( p_mod, i++, &type, 0 ) )
+	{
+		if ( type == SSC_WARNING ) e->warnings.Add( text );
+		else if ( type == SSC_NOTICE ) e->notices.Add( text );
+	}
+
+	wxString folder;
+	size_t disk_limit;
+	{
+		wxMutexLocker _lock( m_lock );
+		folder = m_folder;
+		disk_limit = m_diskLimit;
+	}
+
+	size_t file_bytes = 0;
+	if ( !folder.IsEmpty() && disk_limit > 0 )
+	{
+		if ( !wxDirExists( folder ) )
+			wxFileName::Mkdir( folder, 511, wxPATH_MKDIR_FULL );
+
+		// write to a temporary file first so that concurrent
+		// readers never see a partially written entry
+		wxString file = folder + "/" + key + ".simcache";
+		wxString tmp = file + wxString::Format( ".%lu", (unsigned long)wxThread::GetCurrentId() );
+		if ( WriteEntry( tmp, e.get() ) && wxRenameFile( tmp, file, true ) )
+			file_bytes = (size_t) wxFileName::GetSize( file ).GetValue();
+		else
+			wxRemoveFile( tmp );
+	}
+
+	wxMutexLocker _lock( m_lock );
+
+	m_stats.stores++;
+
+	if ( file_bytes > 0 && m_folder == folder )
+	{
+		if ( !m_diskScanned ) ScanDisk();
+		if ( m_disk.find( key ) == m_disk.end() )
+		{
+			m_diskOrder.push_front( key );
+			DiskItem item;
+			item.bytes = file_bytes;
+			item.pos = m_diskOrder.begin();
+			m_disk[ key ] = item;
+			m_stats.disk_bytes += file_bytes;
+			m_stats.disk_entries++;
+			TrimDisk();
+		}
+	}
+
+	if ( m_mem.find( key ) == m_mem.end() )
+		AddToMemory( key, e );
+}
+
+void SimulationCache::AddToMemory( const wxString &key, const entry_ptr &e )
+{
+	// assumes lock is held
+	if ( e->bytes > m_memLimit )
+		return;
+
+	m_memOrder.push_front( key );
+	MemItem item;
+	item.entry = e;
+	item.pos = m_memOrder.begin();
+	m_mem[ key ] = item;
+	m_stats.memory_bytes += e->bytes;
+	m_stats.memory_entries++;
+
+	TrimMemory();
+}
+
+void SimulationCache::TrimMemory()
+{
+	// assumes lock is held
+	while( m_stats.memory_bytes > m_memLimit && !m_memOrder.empty() )
+	{
+		wxString key = m_memOrder.back();
+		m_memOrder.pop_back();
+
+		auto it = m_mem.find( key );
+		if ( it != m_mem.end() )
+		{
+			m_stats.memory_bytes -= it->second.entry->bytes;
+			m_stats.memory_entries--;
+			m_mem.erase( it );
+			m_stats.evictions++;
+		}
+	}
+}
+
+wxString SimulationCache::DiskFile( const wxString &key )
+{
+	return m_folder + "/" + key + ".simcache";
+}
+
+void SimulationCache::ScanDisk()
+{
+	// assumes lock is held
+	m_diskScanned = true;
+	m_disk.clear();
+	m_diskOrder.clear();
+	m_stats.disk_bytes = 0;
+	m_stats.disk_entries = 0;
+
+	wxDir dir;
+	if ( m_folder.IsEmpty() || !wxDirExists( m_folder ) || !dir.Open( m_folder ) )
+		return;
+
+	// order existing entries by last use, most recent first
+	std::vector< std::pair<time_t, wxString> > files;
+	wxString file;
+	bool has_more = dir.GetFirst( &file, "*.simcache", wxDIR_FILES );
+	while( has_more )
+	{
+		files.push_back( std::make_pair( wxFileModificationTime( m_folder + "/" + file ), file ) );
+		has_more = dir.GetNext( &file );
+	}
+	std::sort( files.begin(), files.end() );
+
+	for( size_t i=0;i<files.size();i++ )
+	{
+		wxString key = wxFileName( files[i].second ).GetName();
+		m_diskOrder.push_front( key );
+		DiskItem item;
+		item.bytes = (size_t) wxFileName::GetSize( m_folder + "/" + files[i].second ).GetValue();
+		item.pos = m_diskOrder.begin();
+		m_disk[ key ] = item;
+		m_stats.disk_bytes += item.bytes;
+		m_stats.disk_entries++;
+	}
+
+	TrimDisk();
+}
+
+void SimulationCache::TrimDisk()
+{
+	// assumes lock is held
+	while( m_stats.disk_bytes > m_diskLimit && !m_diskOrder.empty() )
+	{
+		wxString key = m_diskOrder.back();
+		m_diskOrder.pop_back();
+
+		auto it = m_disk.find( key );
+		if ( it != m_disk.end() )
+		{
+			wxRemoveFile( DiskFile( key ) );
+			m_stats.disk_bytes -= it->second.bytes;
+			m_stats.disk_entries--;
+			m_disk.erase( it );
+			m_stats.evictions++;
+		}
+	}
+}
+
+bool SimulationCache::WriteEntry( const wxString &file, Entry *e )
+{
+	wxFFileOutputStream fos( file );
+	if ( !fos.IsOk() ) return false;
+
+	wxDataOutputStream out( fos );
+	out.Write8( 0x5c );
+	out.Write8( 1 ); // version
+
+	write_array_string( out, e->warnings );
+	write_array_string( out, e->notices );
+	e->outputs.Write( fos );
+
+	out.Write8( 0x5c );
+	return fos.IsOk();
+}
+
+SimulationCache::Entry *SimulationCache::ReadEntry( const wxString &file )
+{
+	wxFFileInputStream fis( file );
+	if ( !fis.IsOk() ) return 0;
+
+	wxDataInputStream in( fis );
+	wxUint8 code = in.Read8();
+	in.Read8(); // version
+	if ( code != 0x5c ) return 0;
+
+	Entry *e = new Entry;
+	e->bytes = 0;
+	read_array_string( in, e->warnings );
+	read_array_string( in, e->notices );
+	if ( !e->outputs.Read( fis ) || in.Read8() != code )
+	{
+		delete e;
+		return 0;
+	}
+
+	for( VarTable::iterator it = e->outputs.begin(); it != e->outputs.end(); ++it )
+		e->bytes += it->first.Len() + value_bytes( *(it->second) );
+
+	return e;
+}
+
+void SimulationCache::Clear( bool disk_too )
+{
+	wxMutexLocker _lock( m_lock );
+	m_mem.clear();
+	m_memOrder.clear();
+	m_stats.memory_bytes = 0;
+	m_stats.memory_entries = 0;
+
+	if ( disk_too && !m_folder.IsEmpty() )
+	{
+		if ( !m_diskScanned ) ScanDisk();
+		for( auto it = m_disk.begin(); it != m_disk.end(); ++it )
+			wxRemoveFile( DiskFile( it->first ) );
+		m_disk.clear();
+		m_diskOrder.clear();
+		m_stats.disk_bytes = 0;
+		m_stats.disk_entries = 0;
+	}
+}
+
+SimulationCache::Stats SimulationCache::GetStats()
+{
+	wxMutexLocker _lock( m_lock );
+	return m_stats;
+}
+
+void SimulationCache::ResetStats()
+{
+	wxMutexLocker _lock( m_lock );
+	m_stats.memory_hits = m_stats.disk_hits = m_stats.misses = m_stats.stores = m_stats.evictions = 0;
+}
@@ -0,0 +1,121 @@
+/**
+BSD-3-Clause
+Copyright 2019 Alliance for Sustainable Energy, LLC
+Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+that the following conditions are met :
+1.	Redistributions of source code must retain the above copyright notice, this list of conditions 
+and the following disclaimer.
+2.	Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+and the following disclaimer in the documentation and/or other materials provided with the distribution.
+3.	Neither the name of the copyright holder nor the names of its contributors may be used to endorse 
+or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER, CONTRIBUTORS, UNITED STATES GOVERNMENT OR UNITED STATES 
+DEPARTMENT OF ENERGY, NOR ANY OF THEIR EMPLOYEES, BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT 
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __simcache_h
+#define __simcache_h
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+#include <wx/string.h>
+#include <wx/arrstr.h>
+#include <wx/thread.h>
+
+#include <ssc/sscapi.h>
+
+#include "variables.h"
+
+// Content-addressed cache of compute module results.
+// Entries are keyed on the compute module name and a hash of every input
+// the module declares, as found in the ssc data container right before the
+// module would run.  A hit restores the module's outputs (and any warnings
+// and notices it logged) into the data container instead of executing it.
+// There is an in-memory LRU tier and an optional on-disk tier, each with a
+// size limit in bytes.  The cache is off unless enabled.
+class SimulationCache
+{
+public:
+	struct Stats
+	{
+		Stats() { memory_hits = disk_hits = misses = stores = evictions = 0; memory_bytes = disk_bytes = 0; memory_entries = disk_entries = 0; }
+		size_t memory_hits, disk_hits, misses, stores, evictions;
+		size_t memory_bytes, disk_bytes;
+		size_t memory_entries, disk_entries;
+	};
+
+	SimulationCache();
+	~SimulationCache();
+
+	// process-wide cache used by Simulation::InvokeWithHandler
+	static SimulationCache &Global();
+
+	// read/save enabled state, limits and folder from/to SamApp::Settings()
+	void LoadSettings();
+	void SaveSettings();
+
+	void Enable( bool b );
+	bool IsEnabled();
+	void SetMemoryLimit( size_t bytes );
+	void SetDiskLimit( size_t bytes );
+	size_t GetMemoryLimit();
+	size_t GetDiskLimit();
+	// an empty folder disables the on-disk tier
+	void SetDiskFolder( const wxString &folder );
+	wxString GetDiskFolder();
+
+	wxString Key( ssc_module_t p_mod, const wxString &cmod, ssc_data_t p_data );
+	bool Lookup( const wxString &key, ssc_data_t p_data, wxArrayString *warnings = 0, wxArrayString *notices = 0 );
+	void Store( const wxString &key, ssc_module_t p_mod, ssc_data_t p_data );
+
+	void Clear( bool disk_too = false );
+	Stats GetStats();
+	void ResetStats();
+
+private:
+	struct Entry
+	{
+		VarTable outputs;
+		wxArrayString warnings, notices;
+		size_t bytes;
+	};
+
+	// entries are shared so a hit can be restored after the lock is released
+	// while a concurrent store or trim evicts it from memory
+	typedef std::shared_ptr<Entry> entry_ptr;
+	typedef std::list<wxString> lru_list_t;
+	struct MemItem { entry_ptr entry; lru_list_t::iterator pos; };
+	struct DiskItem { size_t bytes; lru_list_t::iterator pos; };
+
+	void Restore( Entry *e, ssc_data_t p_data, wxArrayString *warnings, wxArrayString *notices );
+	void AddToMemory( const wxString &key, const entry_ptr &e );
+	void TrimMemory();
+	void ScanDisk();
+	void TrimDisk();
+	wxString DiskFile( const wxString &key );
+	bool WriteEntry( const wxString &file, Entry *e );
+	Entry *ReadEntry( const wxString &file );
+
+	wxMutex m_lock;
+	bool m_enabled;
+	size_t m_memLimit, m_diskLimit;
+	wxString m_folder;
+	bool m_diskScanned;
+
+	lru_list_t m_memOrder, m_diskOrder;
+	std::unordered_map<wxString, MemItem, wxStringHash, wxStringEqual> m_mem;
+	std::unordered_map<wxString, DiskItem, wxStringHash, wxStringEqual> m_disk;
+
+	Stats m_stats;
+};
+
+#endif
@@ -0,0 +1,242 @@
+/**
+BSD-3-Clause
+Copyright 2019 Alliance for Sustainable Energy, LLC
+Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+that the following conditions are met :
+1.	Redistributions of source code must retain the above copyright notice, this list of conditions 
+and the following disclaimer.
+2.	Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+and the following disclaimer in the documentation and/or other materials provided with the distribution.
+3.	Neither the name of the copyright holder nor the names of its contributors may be used to endorse 
+or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER, CONTRIBUTORS, UNITED STATES GOVERNMENT OR UNITED STATES 
+DEPARTMENT OF ENERGY, NOR ANY OF THEIR EMPLOYEES, BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT 
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+
+#include <wx/ffile.h>
+#include <wx/filefn.h>
+#include <wx/tokenzr.h>
+#include <wx/utils.h>
+
+#include "simcost.h"
+#include "simulation.h"
+#include "case.h"
+#include "main.h"
+
+static SimulationCostModel gs_simcost;
+
+void SimulationCostModel::Average::Add( double x )
+{
+	// weight recent runs more, so estimates follow changes in
+	// ssc or the machine, but average over the first few runs
+	count++;
+	double alpha = 1.0 / count;
+	if ( alpha < 0.2 ) alpha = 0.2;
+	msec += alpha * ( x - msec );
+}
+
+SimulationCostModel::SimulationCostModel()
+{
+	m_loaded = false;
+}
+
+SimulationCostModel &SimulationCostModel::Global()
+{
+	return gs_simcost;
+}
+
+wxString SimulationCostModel::FileName()
+{
+	return SamApp::GetUserLocalDataDir() + "/runtimes.txt";
+}
+
+wxString SimulationCostModel::ConfigKey( Simulation *sim )
+{
+	Case *c = sim->GetCase();
+	if ( !c ) return wxEmptyString;
+	return c->GetTechnology() + "/" + c->GetFinancing();
+}
+
+static double prepare_and_run( Simulation *sim )
+{
+	// the quantity kept per configuration: time spent in Prepare() plus the
+	// whole run, or negative if the simulation hasn't run since it was
+	// prepared, or if cached modules made its run unrepresentative
+	if ( sim->GetCacheHits() > 0 ) return -1;
+
+	double total = 0;
+	bool ran = false;
+	std::vector<Simulation::StageTime> &times = sim->GetStageTimes();
+	for( size_t i=0;i<times.size();i++ )
+	{
+		if ( times[i].category == "prepare" )
+			total += times[i].msec;
+		else if ( times[i].category == "run" )
+		{
+			total += times[i].msec;
+			ran = true;
+		}
+	}
+
+	return ran ? total : -1;
+}
+
+void SimulationCostModel::Record( Simulation *sim )
+{
+	if ( !sim->Ok() ) return;
+
+	wxString key = ConfigKey( sim );
+	double total = prepare_and_run( sim );
+	std::vector<Simulation::StageTime> &times = sim->GetStageTimes();
+
+	wxMutexLocker _lock( m_lock );
+	if ( !m_loaded ) Load();
+
+	// modules restored from the cache have no exec time, so only
+	// the modules that actually ran are recorded
+	for( size_t i=0;i<times.size();i++ )
+		if ( times[i].category == "exec" )
+			m_modules[ times[i].name ].Add( times[i].msec );
+
+	if ( !key.IsEmpty() && total > 0 )
+		m_configs[ key ].Add( total );
+}
+
+double SimulationCostModel::EstimateLocked( Simulation *sim )
+{
+	// a simulation that already ran (i.e. a parametric run with new values)
+	// is the best predictor of itself, then other runs of its configuration
+	double self = prepare_and_run( sim );
+	if ( self > 0 )
+		return self;
+
+	AverageHash::iterator it = m_configs.find( ConfigKey( sim ) );
+	if ( it != m_configs.end() )
+		return it->second.msec;
+
+	// finally, the compute modules it will run
+	Case *c = sim->GetCase();
+	ConfigInfo *cfg = c ? c->GetConfiguration() : 0;
+	if ( !cfg ) return -1;
+
+	double total = 0;
+	for( size_t i=0;i<cfg->Simulations.size();i++ )
+	{
+		AverageHash::iterator mit = m_modules.find( "exec: " + cfg->Simulations[i] );
+		if ( mit == m_modules.end() )
+			return -1;
+		total += mit->second.msec;
+	}
+
+	return total;
+}
+
+double SimulationCostModel::Estimate( Simulation *sim )
+{
+	wxMutexLocker _lock( m_lock );
+	if ( !m_loaded ) Load();
+	return EstimateLocked( sim );
+}
+
+void SimulationCostModel::SortLongestFirst( std::vector<Simulation*> &sims )
+{
+	std::vector< std::pair<double, Simulation*> > cost;
+	cost.reserve( sims.size() );
+
+	double known = 0;
+	size_t nknown = 0;
+	{
+		wxMutexLocker _lock( m_lock );
+		if ( !m_loaded ) Load();
+		for( size_t i=0;i<sims.size();i++ )
+		{
+			double est = EstimateLocked( sims[i] );
+			if ( est >= 0 )
+			{
+				known += est;
+				nknown++;
+			}
+			cost.push_back( std::make_pair( est, sims[i] ) );
+		}
+	}
+
+	if ( nknown == 0 ) return;
+
+	double average = known / nknown;
+	for( size_t i=0;i<cost.size();i++ )
+		if ( cost[i].first < 0 )
+			cost[i].first = average;
+
+	std::stable_sort( cost.begin(), cost.end(),
+		[]( const std::pair<double, Simulation*> &a, const std::pair<double, Simulation*> &b ) { return a.first > b.first; } );
+
+	for( size_t i=0;i<cost.size();i++ )
+		sims[i] = cost[i].second;
+}
+
+bool SimulationCostModel::Load()
+{
+	// assumes lock is held
+	m_loaded = true;
+
+	wxFFile fp( FileName(), "r" );
+	if ( !fp.IsOpened() ) return false;
+
+	wxString text;
+	if ( !fp.ReadAll( &text ) ) return false;
+
+	wxArrayString lines = wxStringTokenize( text, "\n" );
+	for( size_t i=0;i<lines.size();i++ )
+	{
+		// kind <tab> name <tab> msec <tab> count
+		wxArrayString cols = wxStringTokenize( lines[i], "\t", wxTOKEN_RET_EMPTY_ALL );
+		double msec = 0;
+		unsigned long count = 0;
+		if ( cols.size() != 4 || !cols[2].ToCDouble( &msec ) || !cols[3].ToULong( &count ) )
+			continue;
+
+		Average avg;
+		avg.msec = msec;
+		avg.count = count;
+		if ( cols[0] == "config" ) m_configs[ cols[1] ] = avg;
+		else if ( cols[0] == "module" ) m_modules[ cols[1] ] = avg;
+	}
+
+	return true;
+}
+
+bool SimulationCostModel::Save()
+{
+	wxMutexLocker _lock( m_lock );
+
+	// write a temporary file and rename it over the old one, so that a
+	// crash or another SAM instance never sees a partially written file
+	wxString file = FileName();
+	wxString tmp = file + wxString::Format( ".%lu", (unsigned long)wxGetProcessId() );
+
+	wxFFile fp( tmp, "w" );
+	if ( !fp.IsOpened() ) return false;
+
+	bool ok = true;
+	for( AverageHash::iterator it = m_configs.begin(); it != m_configs.end(); ++it )
+		ok = fp.Write( wxString::Format( "config\t%s\t%s\t%lu\n", it->first, wxString::FromCDouble( it->second.msec ), (unsigned long)it->second.count ) ) && ok;
+	for( AverageHash::iterator it = m_modules.begin(); it != m_modules.end(); ++it )
+		ok = fp.Write( wxString::Format( "module\t%s\t%s\t%lu\n", it->first, wxString::FromCDouble( it->second.msec ), (unsigned long)it->second.count ) ) && ok;
+
+	if ( !fp.Close() || !ok || !wxRenameFile( tmp, file, true ) )
+	{
+		wxRemoveFile( tmp );
+		return false;
+	}
+
+	return true;
+}
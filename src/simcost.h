@@ -0,0 +1,79 @@
+/**
+BSD-3-Clause
+Copyright 2019 Alliance for Sustainable Energy, LLC
+Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+that the following conditions are met :
+1.	Redistributions of source code must retain the above copyright notice, this list of conditions 
+and the following disclaimer.
+2.	Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+and the following disclaimer in the documentation and/or other materials provided with the distribution.
+3.	Neither the name of the copyright holder nor the names of its contributors may be used to endorse 
+or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER, CONTRIBUTORS, UNITED STATES GOVERNMENT OR UNITED STATES 
+DEPARTMENT OF ENERGY, NOR ANY OF THEIR EMPLOYEES, BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT 
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __simcost_h
+#define __simcost_h
+
+#include <unordered_map>
+#include <vector>
+
+#include <wx/string.h>
+#include <wx/thread.h>
+
+class Simulation;
+
+// Historical run times per configuration and per compute module, used
+// to estimate how long a pending simulation will take so that batches can
+// start the most expensive runs first.  Times are kept as moving averages
+// and saved in the user's local data folder between sessions.
+class SimulationCostModel
+{
+public:
+	SimulationCostModel();
+
+	static SimulationCostModel &Global();
+
+	// add the stage times of a completed simulation
+	void Record( Simulation *sim );
+
+	// expected milliseconds to prepare and run, or a negative number if unknown
+	double Estimate( Simulation *sim );
+
+	// reorder so that the most expensive simulations come first.  simulations
+	// without an estimate are treated as average.  otherwise order is kept
+	void SortLongestFirst( std::vector<Simulation*> &sims );
+
+	bool Load();
+	bool Save();
+
+private:
+	struct Average
+	{
+		Average() : msec( 0 ), count( 0 ) { }
+		void Add( double x );
+		double msec;
+		size_t count;
+	};
+
+	typedef std::unordered_map<wxString, Average, wxStringHash, wxStringEqual> AverageHash;
+
+	wxString FileName();
+	wxString ConfigKey( Simulation *sim );
+	double EstimateLocked( Simulation *sim );
+
+	wxMutex m_lock;
+	bool m_loaded;
+	AverageHash m_configs;
+	AverageHash m_modules;
+};
+
+#endif
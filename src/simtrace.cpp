@@ -0,0 +1,177 @@
+/**
+BSD-3-Clause
+Copyright 2019 Alliance for Sustainable Energy, LLC
+Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+that the following conditions are met :
+1.	Redistributions of source code must retain the above copyright notice, this list of conditions 
+and the following disclaimer.
+2.	Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+and the following disclaimer in the documentation and/or other materials provided with the distribution.
+3.	Neither the name of the copyright holder nor the names of its contributors may be used to endorse 
+or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER, CONTRIBUTORS, UNITED STATES GOVERNMENT OR UNITED STATES 
+DEPARTMENT OF ENERGY, NOR ANY OF THEIR EMPLOYEES, BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT 
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <chrono>
+
+#include <wx/ffile.h>
+
+#include "simtrace.h"
+#include "simulation.h"
+
+static SimulationTrace gs_simtrace;
+
+static std::chrono::steady_clock::time_point gs_epoch = std::chrono::steady_clock::now();
+
+static wxString json_string( const wxString &s )
+{
+	wxString q;
+	for( size_t i=0;i<s.Len();i++ )
+	{
+		wxUniChar c = s[i];
+		if ( c == '"' ) q += "\\\"";
+		else if ( c == '\\' ) q += "\\\\";
+		else if ( c == '\n' ) q += "\\n";
+		else if ( c.GetValue() < 32 ) q += ' ';
+		else q += c;
+	}
+	return "\"" + q + "\"";
+}
+
+SimulationTrace::SimulationTrace()
+{
+	m_enabled = false;
+}
+
+SimulationTrace &SimulationTrace::Global()
+{
+	return gs_simtrace;
+}
+
+void SimulationTrace::Enable( bool b )
+{
+	wxMutexLocker _lock( m_lock );
+	m_enabled = b;
+}
+
+bool SimulationTrace::IsEnabled()
+{
+	wxMutexLocker _lock( m_lock );
+	return m_enabled;
+}
+
+void SimulationTrace::Clear()
+{
+	wxMutexLocker _lock( m_lock );
+	m_events.clear();
+	m_threads.clear();
+	m_stats.clear();
+}
+
+double SimulationTrace::Now()
+{
+	return std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - gs_epoch ).count();
+}
+
+void SimulationTrace::Add( const wxString &name, const wxString &category, const wxString &run, double start_us, double duration_us )
+{
+	wxMutexLocker _lock( m_lock );
+
+	double ms = 0.001*duration_us;
+	Stat &st = m_stats[ name ];
+	st.count++;
+	st.total_ms += ms;
+	if ( ms > st.max_ms ) st.max_ms = ms;
+
+	if ( !m_enabled ) return;
+
+	// number threads in order of appearance so the trace viewer shows one row each
+	wxThreadIdType id = wxThread::GetCurrentId();
+	std::map<wxThreadIdType, int>::iterator it = m_threads.find( id );
+	int thread = 0;
+	if ( it == m_threads.end() )
+	{
+		thread = (int)m_threads.size() + 1;
+		m_threads[ id ] = thread;
+	}
+	else
+		thread = it->second;
+
+	Event e;
+	e.name = name;
+	e.category = category;
+	e.run = run;
+	e.thread = thread;
+	e.start = start_us;
+	e.duration = duration_us;
+	m_events.push_back( e );
+}
+
+std::map<wxString, SimulationTrace::Stat> SimulationTrace::GetStats()
+{
+	wxMutexLocker _lock( m_lock );
+	return m_stats;
+}
+
+size_t SimulationTrace::NumEvents()
+{
+	wxMutexLocker _lock( m_lock );
+	return m_events.size();
+}
+
+bool SimulationTrace::Write( const wxString &file )
+{
+	wxFFile fp( file, "w" );
+	if ( !fp.IsOpened() ) return false;
+
+	wxMutexLocker _lock( m_lock );
+
+	fp.Write( "{\"traceEvents\":[\n" );
+	for( size_t i=0;i<m_events.size();i++ )
+	{
+		Event &e = m_events[i];
+		fp.Write( wxString::Format( "{\"name\":%s,\"cat\":%s,\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d",
+			json_string( e.name ), json_string( e.category ), e.start, e.duration, e.thread ) );
+		if ( !e.run.IsEmpty() )
+			fp.Write( ",\"args\":{\"run\":" + json_string( e.run ) + "}" );
+		fp.Write( i+1 < m_events.size() ? "},\n" : "}\n" );
+	}
+	fp.Write( "],\"displayTimeUnit\":\"ms\"}\n" );
+
+	return fp.Close();
+}
+
+SimulationTimer::SimulationTimer( Simulation *sim, const wxString &category, const wxString &detail )
+	: m_sim( sim ), m_category( category )
+{
+	m_name = detail.IsEmpty() ? category : category + ": " + detail;
+	m_start = SimulationTrace::Global().Now();
+	m_running = true;
+}
+
+SimulationTimer::~SimulationTimer()
+{
+	Stop();
+}
+
+void SimulationTimer::Stop()
+{
+	if ( !m_running ) return;
+	m_running = false;
+
+	SimulationTrace &trace = SimulationTrace::Global();
+	double duration = trace.Now() - m_start;
+
+	if ( m_sim )
+		m_sim->AddStageTime( m_name, m_category, 0.001*duration );
+
+	trace.Add( m_name, m_category, m_sim ? m_sim->GetName() : wxString(), m_start, duration );
+}
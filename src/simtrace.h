@@ -0,0 +1,100 @@
+/**
+BSD-3-Clause
+Copyright 2019 Alliance for Sustainable Energy, LLC
+Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+that the following conditions are met :
+1.	Redistributions of source code must retain the above copyright notice, this list of conditions 
+and the following disclaimer.
+2.	Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+and the following disclaimer in the documentation and/or other materials provided with the distribution.
+3.	Neither the name of the copyright holder nor the names of its contributors may be used to endorse 
+or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER, CONTRIBUTORS, UNITED STATES GOVERNMENT OR UNITED STATES 
+DEPARTMENT OF ENERGY, NOR ANY OF THEIR EMPLOYEES, BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT 
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __simtrace_h
+#define __simtrace_h
+
+#include <map>
+#include <vector>
+
+#include <wx/string.h>
+#include <wx/thread.h>
+
+class Simulation;
+
+// Collects the time spent in each stage of every simulation run.
+// Aggregate statistics per stage are always kept.  When enabled, every
+// individual stage is also recorded as an event that can be written out
+// as a Chrome/Perfetto trace (chrome://tracing, ui.perfetto.dev).
+class SimulationTrace
+{
+public:
+	struct Stat
+	{
+		Stat() : count( 0 ), total_ms( 0 ), max_ms( 0 ) { }
+		size_t count;
+		double total_ms, max_ms;
+	};
+
+	SimulationTrace();
+
+	static SimulationTrace &Global();
+
+	void Enable( bool b );
+	bool IsEnabled();
+	void Clear();
+
+	// microseconds since the trace was created
+	double Now();
+
+	void Add( const wxString &name, const wxString &category, const wxString &run, double start_us, double duration_us );
+
+	std::map<wxString, Stat> GetStats();
+	size_t NumEvents();
+	bool Write( const wxString &file );
+
+private:
+	struct Event
+	{
+		wxString name, category, run;
+		int thread;
+		double start, duration;
+	};
+
+	wxMutex m_lock;
+	bool m_enabled;
+	std::vector<Event> m_events;
+	std::map<wxThreadIdType, int> m_threads;
+	std::map<wxString, Stat> m_stats;
+};
+
+// times a stage of a simulation for the lifetime of the object.
+// the result goes to the simulation's list of stage times and to the
+// global trace.  the stage is named "category: detail", or just the
+// category if there is no detail.  sim may be null for stages that
+// are not part of one run, e.g. a whole batch
+class SimulationTimer
+{
+public:
+	SimulationTimer( Simulation *sim, const wxString &category, const wxString &detail = wxEmptyString );
+	~SimulationTimer();
+
+	void Stop();
+
+private:
+	Simulation *m_sim;
+	wxString m_category, m_name;
+	double m_start;
+	bool m_running;
+};
+
+#endif
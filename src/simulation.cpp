@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <atomic>
 
 #include <wx/datstrm.h>
 #include <wx/gauge.h>
@@ -22,6 +23,9 @@
 #include <ssc/sscapi.h>
 
 #include "simulation.h"
+#include "simcache.h"
+#include "simtrace.h"
+#include "simcost.h"
 #include "main.h"
 #include "equations.h"
 #include "case.h"
@@ -29,21 +33,17 @@
 
 bool VarValueToSSC( VarValue *vv, ssc_data_t pdata, const wxString &sscname )
 {
-    auto var = ssc_var_create();
-    if (!vv->AsSSCVar(var)){
-        ssc_var_free(var);
-        return false;
-    }
-    ssc_data_set_var(pdata, sscname.c_str(), var);
-    ssc_var_free(var);
-    return true;
+    // numeric inputs go from the VarValue buffer into ssc in one copy
+    return vv->AssignSSCData(pdata, sscname.c_str());
 }
 
 Simulation::Simulation( Case *cc, const wxString &name )
 	: m_case( cc ), m_name( name )
 {
+	m_singleValuesOnly = false;
 	m_totalElapsedMsec = 0;
 	m_sscElapsedMsec = 0;
+	m_cacheHits = 0;
 }
 
 
@@ -72,7 +72,16 @@ void Simulation::Write( wxOutputStream &os )
 
 	write_array_string( out, m_overrides );
 
-	m_inputs.Write( os );
+	if ( m_inputs.GetBase() )
+	{
+		// save the complete set of inputs, not just the layer over the shared values
+		VarTable inputs( m_inputs );
+		inputs.Flatten();
+		inputs.Write( os );
+	}
+	else
+		m_inputs.Write( os );
+
 	m_outputs.Write( os, SamApp::Project().GetSaveHourlyData() ? 0 : 1024 );
 	
 	write_array_string( out, m_errors );
@@ -127,6 +136,10 @@ void Simulation::Copy( const Simulation &rh )
 	m_outputLabels = rh.m_outputLabels;
 	m_outputUnits = rh.m_outputUnits;
 	m_uiHints = rh.m_uiHints;
+	m_outputFilter = rh.m_outputFilter;
+	m_singleValuesOnly = rh.m_singleValuesOnly;
+	m_stageTimes = rh.m_stageTimes;
+	m_cacheHits = rh.m_cacheHits;
 }
 
 void Simulation::Clear()
@@ -141,6 +154,16 @@ void Simulation::Clear()
 	m_outputLabels.clear();
 	m_outputUnits.clear();
 	m_uiHints.clear();
+	m_stageTimes.clear();
+}
+
+void Simulation::AddStageTime( const wxString &name, const wxString &category, double msec )
+{
+	StageTime st;
+	st.name = name;
+	st.category = category;
+	st.msec = msec;
+	m_stageTimes.push_back( st );
 }
 
 void Simulation::Override( const wxString &name, const VarValue &val )
@@ -176,6 +199,42 @@ wxString Simulation::GetOverridesLabel( bool with_labels )
 	return tag;
 }
 
+void Simulation::SetOutputFilter( const wxArrayString &names, bool single_values )
+{
+	m_outputFilter.clear();
+	for( size_t i=0;i<names.size();i++ )
+		m_outputFilter.insert( names[i] );
+	m_singleValuesOnly = single_values;
+}
+
+void Simulation::SetOutputFilter( bool single_values )
+{
+	m_outputFilter.clear();
+	m_singleValuesOnly = single_values;
+}
+
+void Simulation::ClearOutputFilter()
+{
+	m_outputFilter.clear();
+	m_singleValuesOnly = false;
+}
+
+bool Simulation::IsOutputKept( const wxString &name, int ssc_data_type )
+{
+	if ( m_singleValuesOnly && ssc_data_type != SSC_NUMBER )
+		return false;
+
+	return m_outputFilter.empty()
+		|| m_outputFilter.find( name ) != m_outputFilter.end();
+}
+
+VarTable *Simulation::GetInputVarTable()
+{
+	// callers may iterate the table, so make sure it holds all values
+	m_inputs.Flatten();
+	return &m_inputs;
+}
+
 VarValue *Simulation::GetInput( const wxString &name )
 {
 	if ( VarValue *val = m_inputs.Get( name ) )
@@ -378,6 +437,9 @@ bool Simulation::Invoke( bool silent, bool prepare, wxString folder )
 	return ok;
 }
 
+// Prepare only reads from the case (values, variable info, equations, libraries)
+// and writes to this simulation's own tables, so several simulations of
+// the same case can be prepared concurrently by the dispatcher's worker threads
 bool Simulation::Prepare()
 {	
 	ConfigInfo *cfg = m_case->GetConfiguration();
@@ -393,17 +455,25 @@ bool Simulation::Prepare()
 	m_outputLabels.clear();
 	m_outputUnits.clear();
 	m_uiHints.clear();
+	m_stageTimes.clear();
 
-	// transfer all the values except for ones that have been 'overriden'
-	for( VarTableBase::const_iterator it = m_case->Values().begin();
-		it != m_case->Values().end();
-		++it )
-		if ( 0 == m_inputs.Get( it->first ) )
-			m_inputs.Set( it->first, *(it->second) );
+	// transfer all the values except for ones that have been 'overriden'.
+	// when the case values are shared via SetBaseInputs, there is nothing to copy
+	if ( !m_inputs.GetBase() )
+	{
+		SimulationTimer timer( this, "prepare", "copy inputs" );
+		for( VarTableBase::const_iterator it = m_case->Values().begin();
+			it != m_case->Values().end();
+			++it )
+			if ( 0 == m_inputs.Get( it->first ) )
+				m_inputs.Set( it->first, *(it->second) );
+	}
 
 	// recalculate all the equations
+	SimulationTimer eval_timer( this, "prepare", "equations" );
 	CaseEvaluator eval( m_case, m_inputs, m_case->Equations() );
 	int n = eval.CalculateAll();
+	eval_timer.Stop();
 
 	if ( n < 0 )
 	{
@@ -414,8 +484,6 @@ bool Simulation::Prepare()
 		return false;
 	}
 	
-	//wxLogStatus("Simulation preparation time: %d copy, %d eval", (int)time_copy, (int)time_eval);
-
 	return true;
 }
 
@@ -679,8 +747,16 @@ bool Simulation::InvokeWithHandler(ISimulationHandler *ih, wxString folder)
 
 	m_totalElapsedMsec = 0;
 	m_sscElapsedMsec = 0;
+	m_cacheHits = 0;
 	wxStopWatch sw;
 
+	// keep the stage times from Prepare(), drop those of any earlier run
+	for( size_t i=m_stageTimes.size();i>0;i-- )
+		if ( m_stageTimes[i-1].category != "prepare" )
+			m_stageTimes.erase( m_stageTimes.begin() + (i-1) );
+
+	SimulationTimer run_timer( this, "run" );
+
 	ssc_data_t p_data = ssc_data_create();
 
 	if ( m_simlist.size() == 0 )
@@ -695,7 +771,10 @@ bool Simulation::InvokeWithHandler(ISimulationHandler *ih, wxString folder)
             return false;
         }
 
-		if (!CmodInputsToSSCData(p_mod, p_data)){
+		SimulationTimer inputs_timer( this, "inputs", m_simlist[kk] );
+		bool inputs_ok = CmodInputsToSSCData(p_mod, p_data);
+		inputs_timer.Stop();
+		if (!inputs_ok){
 		    ih->Error(ssc_data_get_string(p_data, "error"));
 		}
 
@@ -703,9 +782,39 @@ bool Simulation::InvokeWithHandler(ISimulationHandler *ih, wxString folder)
 		wxString fn = folder + "/ssc-" + m_simlist[kk] + ".lk";
 		ih->WriteDebugFile( fn, p_mod, p_data );
 		//ih->WriteDebugFile( m_simlist[kk], p_mod, p_data );
-		
+
+		// identical inputs to a compute module give identical outputs, so
+		// a cached result is restored into p_data instead of running it again
+		SimulationCache &cache = SimulationCache::Global();
+		wxString cache_key;
+		wxArrayString cached_warnings, cached_notices;
+		bool cached = false;
 		wxStopWatch ssctime;
-		ssc_bool_t ok = ssc_module_exec_with_handler( p_mod, p_data, ssc_invoke_handler, ih );
+		if ( inputs_ok && cache.IsEnabled() )
+		{
+			SimulationTimer cache_timer( this, "cache", m_simlist[kk] );
+			cache_key = cache.Key( p_mod, m_simlist[kk], p_data );
+			cached = cache.Lookup( cache_key, p_data, &cached_warnings, &cached_notices );
+		}
+
+		ssc_bool_t ok;
+		if ( cached )
+		{
+			m_cacheHits++;
+			for( size_t i=0;i<cached_warnings.size();i++ )
+				ih->Warn( cached_warnings[i] );
+			for( size_t i=0;i<cached_notices.size();i++ )
+				ih->Notice( cached_notices[i] );
+			ok = 1;
+		}
+		else
+		{
+			SimulationTimer exec_timer( this, "exec", m_simlist[kk] );
+			ok = ssc_module_exec_with_handler( p_mod, p_data, ssc_invoke_handler, ih );
+			exec_timer.Stop();
+			if ( ok && !cache_key.IsEmpty() )
+				cache.Store( cache_key, p_mod, p_data );
+		}
 		m_sscElapsedMsec += (int)ssctime.Time();
 
 		if ( !ok )
@@ -714,12 +823,19 @@ bool Simulation::InvokeWithHandler(ISimulationHandler *ih, wxString folder)
 		}
 		else
 		{
+			SimulationTimer outputs_timer( this, "outputs", m_simlist[kk] );
 			int pidx = 0;
 			while( const ssc_info_t p_inf = ssc_module_var_info( p_mod, pidx++ ) )
 			{
 				int var_type = ssc_info_var_type( p_inf );   // SSC_INPUT, SSC_OUTPUT, SSC_INOUT
 				int data_type = ssc_info_data_type( p_inf ); // SSC_STRING, SSC_NUMBER, SSC_ARRAY, SSC_MATRIX		
 				const char *name = ssc_info_name( p_inf ); // assumed to be non-null
+
+				// outputs excluded by the filter are still available to later
+				// compute modules through p_data, they just aren't stored here
+				if ( !IsOutputKept( name, data_type ) )
+					continue;
+
 				wxString label( ssc_info_label( p_inf ) );
 				wxString units( ssc_info_units( p_inf ) );
 				wxString ui_hint(ssc_info_uihint(p_inf));
@@ -736,7 +852,7 @@ bool Simulation::InvokeWithHandler(ISimulationHandler *ih, wxString folder)
 
 						m_outputList.Add( name );
 						VarValue *vv = m_outputs.Create( name, VV_NUMBER );
-						vv->Set( (float) vval );
+						vv->Set( (double) vval );
 						
 						m_outputLabels[ name ] = label;
 						m_outputUnits[ name ] = units;
@@ -752,13 +868,11 @@ bool Simulation::InvokeWithHandler(ISimulationHandler *ih, wxString folder)
 							m_outputList.Remove(name);
 						}
 						m_outputList.Add( name );
-						VarValue *vv = m_outputs.Create( name, VV_ARRAY );
-						double *ff = new double[len];
-						for( int i=0;i<len;i++ )
-							ff[i] = (double)(varr[i]);
 
-						vv->Set( ff, (size_t)len );
-						delete [] ff;
+						// ssc_data_get_array returns the module's own buffer, so
+						// this is the only copy: one bulk assignment into the VarValue
+						VarValue *vv = m_outputs.Create( name, VV_ARRAY );
+						vv->Set( varr, (size_t)len );
 						
 						m_outputLabels[ name ] = label;
 						m_outputUnits[ name ] = units;
@@ -775,19 +889,10 @@ bool Simulation::InvokeWithHandler(ISimulationHandler *ih, wxString folder)
 							m_outputList.Remove(name);
 						}
 						m_outputList.Add(name);
-						VarValue *vv = m_outputs.Create(name, VV_MATRIX);
-						matrix_t<double> ff(nr, nc);
 
-						int count = 0;
-						for (int i = 0; i < nr; i++)
-						{
-							for (int j = 0; j < nc; j++)
-							{
-								ff(i, j) = (double)(varr[count]);
-								count++;
-							}
-						}
-						vv->Set(ff);
+						// ssc matrices are row-major like matrix_t, so copy in one block
+						VarValue *vv = m_outputs.Create(name, VV_MATRIX);
+						vv->Set(varr, (size_t)nr, (size_t)nc);
 						m_outputLabels[name] = label;
 						m_outputUnits[name] = units;
 						if (!ui_hint.IsEmpty()) m_uiHints[name] = ui_hint;
@@ -808,6 +913,7 @@ bool Simulation::InvokeWithHandler(ISimulationHandler *ih, wxString folder)
 	m_notices = ih->GetNotices();
 	
 	m_totalElapsedMsec = (int) sw.Time();
+	run_timer.Stop();
 
 	return m_errors.size() == 0;
 
@@ -969,76 +1075,138 @@ bool Simulation::ListAllOutputs( ConfigInfo *cfg,
 }
 
 
+// shared pool of pending simulations that all worker threads pull from,
+// so that a thread that finishes early picks up the next available run
+// rather than sitting idle while others work through a static assignment.
+// the queue also carries the notification channel that workers use to
+// wake up the dispatching thread when progress is made or a run completes
+class SimulationQueue
+{
+	std::vector<Simulation*> &m_sims;
+	size_t m_next;
+	bool m_pending;
+	wxMutex m_lock;
+	wxCondition m_signal;
+public:
+	SimulationQueue( std::vector<Simulation*> &sims )
+		: m_sims( sims ), m_next( 0 ), m_pending( false ), m_signal( m_lock ) {
+	}
+
+	Simulation *Next() {
+		wxMutexLocker _lock( m_lock );
+		if ( m_next < m_sims.size() )
+			return m_sims[ m_next++ ];
+		else
+			return 0;
+	}
+
+	size_t Remaining() {
+		wxMutexLocker _lock( m_lock );
+		return m_sims.size() - m_next;
+	}
+
+	size_t Size() { return m_sims.size(); }
+
+	// called by worker threads
+	void Notify() {
+		wxMutexLocker _lock( m_lock );
+		m_pending = true;
+		m_signal.Signal();
+	}
+
+	// called by the dispatching thread: returns as soon as any worker has
+	// posted an event, or after the timeout so the UI can still be serviced
+	void WaitForEvent( unsigned long msec ) {
+		wxMutexLocker _lock( m_lock );
+		if ( !m_pending )
+			m_signal.WaitTimeout( msec );
+		m_pending = false;
+	}
+};
+
+// progress state shared between a worker thread and the dispatcher.
+// everything except the text fields is lock-free
+struct SimulationProgress
+{
+	SimulationProgress() : current( 0 ), nok( 0 ), percent( 0.0f ), notified( -1 ),
+		running( false ), finished( false ), canceled( false ) { }
+
+	std::atomic<size_t> current;
+	std::atomic<size_t> nok;
+	std::atomic<float> percent;
+	std::atomic<int> notified; // whole percent last reported to the dispatcher
+	std::atomic<bool> running;
+	std::atomic<bool> finished;
+	std::atomic<bool> canceled;
+};
+
 class SimulationThread : public wxThread, ISimulationHandler
 {
-	std::vector<Simulation*> m_list;
-	wxMutex m_currentLock, m_cancelLock, m_nokLock, m_logLock, m_percentLock;
-	size_t m_current;
-	bool m_canceled;
-	size_t m_nok;
+	SimulationQueue *m_queue;
+	size_t m_nthreads;
+	bool m_prepare;
+	SimulationProgress m_progress;
+	wxMutex m_textLock;
 	wxArrayString m_messages;
 	wxString m_update;
 	wxString m_curName;
-	float m_percent;
 	int m_threadId;
 public:
 
-	SimulationThread( int id )
+	SimulationThread( int id, SimulationQueue *queue, size_t nthreads, bool prepare )
 		: wxThread( wxTHREAD_JOINABLE ) {
-		m_canceled = false;
+		m_queue = queue;
+		m_nthreads = nthreads > 0 ? nthreads : 1;
+		m_prepare = prepare;
 		m_threadId = id;
-		m_nok = 0;
-		m_percent = 0;
-		m_current = 0;
-	}
-	
-	void Add( Simulation *s ) {
-		m_list.push_back( s );
 	}
 
-	size_t Size() { return m_list.size(); }
-	size_t Current() { 
-		wxMutexLocker _lock( m_currentLock );
-		return m_current;
-	}
+	size_t Current() { return m_progress.current; }
+	bool Finished() { return m_progress.finished; }
+
 	float GetPercent( wxString *update = 0) {
-		size_t ns = Size();
-		size_t cur = Current();
-		wxMutexLocker _lock(m_percentLock);
-		float curper = m_percent;
+		size_t cur = m_progress.current;
+		size_t running = m_progress.running ? 1 : 0;
+		float curper = m_progress.percent;
 
 		if ( update != 0 )
+		{
+			wxMutexLocker _lock(m_textLock);
 			*update = m_update;
+		}
 
-		if ( ns == 0 ) return 0.0f;
+		if ( m_queue->Size() == 0 ) return 0.0f;
 
-		if ( cur < ns )
-		{
-			float each = 100/ns;
-			float overall = cur*each + 0.01*curper*each;
-			return overall;
-		}
-		else
+		// runs are pulled from the shared queue as threads become free, so
+		// estimate this thread's share of the batch as what it has already
+		// done plus its fair share of what is still waiting in the queue
+		float remaining = (float)m_queue->Remaining() / (float)m_nthreads;
+		float total = (float)(cur + running) + remaining;
+		if ( total <= 0.0f || ( running == 0 && remaining == 0.0f ) )
 			return 100.0f;
+
+		float overall = 100.0f * ( cur + 0.01f*curper*running ) / total;
+		return overall < 100.0f ? overall : 100.0f;
 	}
 
 	void Cancel()
 	{
-		wxMutexLocker _lock(m_cancelLock);
-		m_canceled = true;
+		m_progress.canceled = true;
 	}
 
 	size_t NOk() {
-		wxMutexLocker _lock(m_nokLock);
-		return m_nok;
+		return m_progress.nok;
 	}
 	
 	void Message( const wxString &text )
 	{
-		wxMutexLocker _lock(m_logLock);
-		wxString L( m_curName );
-		if ( !L.IsEmpty() ) L += ": ";
-		m_messages.Add( L + text );
+		{
+			wxMutexLocker _lock(m_textLock);
+			wxString L( m_curName );
+			if ( !L.IsEmpty() ) L += ": ";
+			m_messages.Add( L + text );
+		}
+		m_queue->Notify();
 	}
 	
 	virtual void Warn( const wxString &text )
@@ -1055,20 +1223,27 @@ public:
 
 	virtual void Update( float percent, const wxString &text )
 	{
-		wxMutexLocker _lock(m_percentLock);
-		m_percent = percent;
-		m_update = text;
+		m_progress.percent = percent;
+		{
+			wxMutexLocker _lock(m_textLock);
+			m_update = text;
+		}
+
+		// ssc reports progress far more often than the display changes,
+		// so only wake the dispatcher when the whole percent moves
+		int whole = (int)percent;
+		if ( m_progress.notified.exchange( whole ) != whole )
+			m_queue->Notify();
 	}
 
 
 	virtual bool IsCancelled() {
-		wxMutexLocker _lock(m_cancelLock);
-		return m_canceled;
+		return m_progress.canceled;
 	}
 	
 	wxArrayString GetNewMessages()
 	{
-		wxMutexLocker _lock(m_logLock);
+		wxMutexLocker _lock(m_textLock);
 		wxArrayString list = m_messages;
 		m_messages.Clear();
 		return list;
@@ -1076,64 +1251,98 @@ public:
 
 	virtual void *Entry()
 	{
-		m_canceled = false;
-		for( size_t i=0;i<m_list.size();i++ )
+		while( !IsCancelled() )
 		{
-			m_curName = m_list[i]->GetName();
+			Simulation *sim = m_queue->Next();
+			if ( !sim ) break;
+
+			{
+				wxMutexLocker _lock(m_textLock);
+				m_curName = sim->GetName();
+			}
+
+			m_progress.percent = 0.0f;
+			m_progress.notified = -1;
+			m_progress.running = true;
 
 			// clear any saved messages from the previous simulation
 			ClearSavedMessages();
-			if ( m_list[i]->InvokeWithHandler( this ) )
+			if ( m_prepare && !sim->Prepare() )
 			{
-				wxMutexLocker _lock(m_nokLock);
-				m_nok++;
+				// preparation errors are kept on the simulation itself
+				wxArrayString &errs = sim->GetErrors();
+				for( size_t k=0;k<errs.size();k++ )
+					Message( errs[k] );
 			}
+			else if ( sim->InvokeWithHandler( this ) )
+				m_progress.nok++;
 
-			m_currentLock.Lock();
-			m_current++;
-			m_currentLock.Unlock();
-
-			wxMutexLocker _lock(m_cancelLock);
-			if (m_canceled) break;
+			m_progress.current++;
+			m_progress.running = false;
+			m_queue->Notify();
 		}
 
+		m_progress.finished = true;
+		m_queue->Notify();
+
 		return 0;
 	}
 };
 
 int Simulation::DispatchThreads( SimulationDialog &tpd, 
 	std::vector<Simulation*> &sims, 
-	int nthread )
+	int nthread, bool prepare )
 {
-	return DispatchThreads( tpd.Dialog(), sims, nthread );
+	return DispatchThreads( tpd.Dialog(), sims, nthread, prepare );
 } 
 
+class ThreadProgressMonitor : public ISimulationMonitor
+{
+	wxThreadProgressDialog &m_tpd;
+public:
+	ThreadProgressMonitor( wxThreadProgressDialog &tpd ) : m_tpd( tpd ) { }
+
+	virtual void Update( int thread, float percent, const wxString &text ) { m_tpd.Update( thread, percent, text ); }
+	virtual void Log( const wxArrayString &messages ) { m_tpd.Log( messages ); }
+	virtual bool IsCanceled() { return m_tpd.IsCanceled(); }
+	virtual void Yield() { wxGetApp().Yield(); }
+};
+
 int Simulation::DispatchThreads( wxThreadProgressDialog &tpd, 
 	std::vector<Simulation*> &sims, 
-	int nthread )
+	int nthread, bool prepare )
+{
+	ThreadProgressMonitor mon( tpd );
+	return DispatchThreads( mon, sims, nthread, prepare );
+}
+
+int Simulation::DispatchThreads( ISimulationMonitor &mon, 
+	std::vector<Simulation*> &sims, 
+	int nthread, bool prepare )
 {	
+	SimulationTimer batch_timer( 0, "batch" );
 	wxStopWatch sw;
 
 	// no need to create extra unnecessary threads 
 	if (nthread > (int)sims.size()) nthread = sims.size();
 
+	// start the runs expected to take longest first, based on earlier run
+	// times, so that the batch doesn't end with one long run on its own
+	SimulationCostModel &costs = SimulationCostModel::Global();
+	std::vector<Simulation*> ordered( sims );
+	costs.SortLongestFirst( ordered );
+
+	// all threads pull the next pending simulation from a common queue
+	SimulationQueue queue( ordered );
+
 	std::vector<SimulationThread*> threads;
 	for( int i=0;i<nthread;i++)
 	{
-		SimulationThread *t = new SimulationThread( i );
+		SimulationThread *t = new SimulationThread( i, &queue, (size_t)nthread, prepare );
 		threads.push_back( t );
 		t->Create();
 	}
 
-	// round robin assign each simulation to a thread
-	size_t ithr = 0;
-	for( size_t i=0;i<sims.size();i++ )
-	{
-		threads[ithr++]->Add( sims[i] );
-		if ( ithr == threads.size() )
-			ithr = 0;
-	}
-
 	sw.Start();
 	
 	// start the threads
@@ -1144,7 +1353,7 @@ int Simulation::DispatchThreads( wxThreadProgressDialog &tpd,
 	{
 		size_t i, num_finished = 0;
 		for (i=0;i<threads.size();i++)
-			if (!threads[i]->IsRunning())
+			if (threads[i]->Finished())
 				num_finished++;
 
 		if (num_finished == threads.size())
@@ -1155,21 +1364,23 @@ int Simulation::DispatchThreads( wxThreadProgressDialog &tpd,
 		{
 			wxString update;
 			float per = threads[i]->GetPercent(&update);
-			tpd.Update(i, per, update);
+			mon.Update(i, per, update);
 			wxArrayString msgs = threads[i]->GetNewMessages();
-			tpd.Log( msgs );
+			mon.Log( msgs );
 		}
 
-		wxGetApp().Yield();
+		mon.Yield();
 
 		// if dialog's cancel button was pressed, send cancel signal to all threads
-		if (tpd.IsCanceled())
+		if (mon.IsCanceled())
 		{
 			for (i=0;i<threads.size();i++)
 				threads[i]->Cancel();
 		}
 
-		::wxMilliSleep( 100 );
+		// sleep until a worker reports progress, a message or a completed
+		// run; the timeout only bounds how long the UI goes without a yield
+		queue.WaitForEvent( 100 );
 	}
 
 	
@@ -1182,11 +1393,11 @@ int Simulation::DispatchThreads( wxThreadProgressDialog &tpd,
 
 		// update final progress
 		float per = threads[i]->GetPercent();
-		tpd.Update(i, per);
+		mon.Update(i, per, wxEmptyString);
 
 		// get any final simulation messages
 		wxArrayString msgs = threads[i]->GetNewMessages();
-		tpd.Log( msgs );
+		mon.Log( msgs );
 	}
 	
 	// delete all the thread objects
@@ -1194,6 +1405,10 @@ int Simulation::DispatchThreads( wxThreadProgressDialog &tpd,
 		delete threads[i];
 
 	threads.clear();
+
+	for (size_t i=0;i<sims.size();i++)
+		costs.Record( sims[i] );
+	costs.Save();
 	
 	return nok;
 }
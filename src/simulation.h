@@ -24,6 +24,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define __simulation_h
 
 #include <map>
+#include <unordered_set>
 
 #include <wx/string.h>
 #include <wx/stream.h>
@@ -72,6 +73,22 @@ public:
 		ssc_data_t ) { return false; }
 };
 
+// receives progress from Simulation::DispatchThreads.  the interactive
+// application uses the thread progress dialog, the headless batch runner
+// reports to the console
+class ISimulationMonitor
+{
+public:
+	virtual ~ISimulationMonitor() { }
+
+	virtual void Update( int thread, float percent, const wxString &text ) = 0;
+	virtual void Log( const wxArrayString &messages ) = 0;
+	virtual bool IsCanceled() = 0;
+
+	// called periodically on the dispatching thread, i.e. to process UI events
+	virtual void Yield() { }
+};
+
 class wxThreadProgressDialog;
 class SimulationDialog;
 
@@ -97,9 +114,17 @@ public:
 	wxString GetOverridesLabel( bool with_labels = true );
 	void SetName( const wxString &s ) { m_name = s; }
 	wxString GetName() { return m_name; }
+	// inputs may live in the table shared by SetBaseInputs, so the returned
+	// values are for reading only: use Override() to change an input
 	VarValue *GetInput( const wxString &name );
 	void SetInput(const wxString & name, lk::vardata_t val);
 
+	// share one read-only copy of the case values between many simulations.
+	// Prepare() then layers the overrides and calculated values over it
+	// instead of copying every case value into this simulation's inputs.
+	// must be set after Clear(), which drops it
+	void SetBaseInputs( std::shared_ptr<VarTable> values ) { m_inputs.SetBase( values ); }
+
 	// generate code
 	bool Generate_lk(FILE *fp);
 
@@ -116,7 +141,18 @@ public:
 	// returns an output or input, outputs have precedence
 	VarValue *GetValue( const wxString &name );
 
-	VarTable *GetInputVarTable() { return &m_inputs; }
+	// restrict which outputs are kept when the simulation runs. by default all
+	// outputs of every compute module are stored.  batch runs that only need a few
+	// results can limit storage to a list of names and/or to single values only.
+	// the filter is kept across Clear() so runs can be reused
+	void SetOutputFilter( const wxArrayString &names, bool single_values = false );
+	void SetOutputFilter( bool single_values );
+	void ClearOutputFilter();
+	bool IsOutputKept( const wxString &name, int ssc_data_type );
+
+	// for callers that iterate or edit the inputs: this copies the shared
+	// values into this simulation, giving up the memory they saved
+	VarTable *GetInputVarTable();
 
 	bool CmodInputsToSSCData(ssc_module_t p_mod, ssc_data_t p_data);
 	bool GetInputsSSCData(ssc_data_t p_data);
@@ -127,7 +163,7 @@ public:
 	// prepares and runs simulation
 	bool Invoke(bool silent=false, bool prepare=true, wxString folder=wxEmptyString);
 	
-	bool Prepare(); // not threadable, but must be called before below
+	bool Prepare(); // must be called before below. safe to call concurrently for different simulations of the same case
 	bool InvokeWithHandler(ISimulationHandler *ih, wxString folder = wxEmptyString); // updates elapsed time
 
 	// results and messages if it succeeded
@@ -146,18 +182,31 @@ public:
 		wxArrayString* types,
 		bool single_values = false );
 
+	// if 'prepare' is true, each simulation is prepared by the worker
+	// thread that runs it, rather than requiring the caller to call Prepare() beforehand
 	static int DispatchThreads( wxThreadProgressDialog &tpd, 
 		std::vector<Simulation*> &sims, 
-		int nthread );
+		int nthread, bool prepare = false );
 	static int DispatchThreads( SimulationDialog &tpd, 
 		std::vector<Simulation*> &sims, 
-		int nthread );
+		int nthread, bool prepare = false );
+	static int DispatchThreads( ISimulationMonitor &mon, 
+		std::vector<Simulation*> &sims, 
+		int nthread, bool prepare = false );
 
 	// total time for creating data container, model, setting inputs, running simulation
 	int GetTotalElapsedTime() { return m_totalElapsedMsec; }
 	// SSC compute module execution time only
 	int GetSSCElapsedTime() { return m_sscElapsedMsec; }
 
+	// time in milliseconds spent in each stage of the last Prepare() and run,
+	// e.g. "prepare: equations" or "exec: pvsamv1".  see SimulationTimer
+	struct StageTime { wxString name, category; double msec; };
+	void AddStageTime( const wxString &name, const wxString &category, double msec );
+	std::vector<StageTime> &GetStageTimes() { return m_stageTimes; }
+	// compute modules restored from the simulation cache in the last run
+	int GetCacheHits() { return m_cacheHits; }
+
 	wxArrayString GetModels() { return m_simlist; }
 
 protected:
@@ -171,8 +220,12 @@ protected:
 	wxArrayString m_errors, m_warnings, m_notices;
 
 	StringHash m_outputLabels, m_outputUnits, m_uiHints;
+	std::unordered_set<wxString, wxStringHash, wxStringEqual> m_outputFilter;
+	bool m_singleValuesOnly;
 	int m_sscElapsedMsec;
 	int m_totalElapsedMsec;
+	int m_cacheHits;
+	std::vector<StageTime> m_stageTimes;
 };
 
 
@@ -2168,6 +2168,9 @@ void StochasticPanel::Simulate()
 
 	int count_sims = 1;
 
+	// all samples share one copy of the case values
+	std::shared_ptr<VarTable> base_inputs = std::make_shared<VarTable>(m_case->Values());
+
 
 
 	for (int i = 0; i < m_sd.N; i++)
@@ -2175,6 +2178,10 @@ void StochasticPanel::Simulate()
 		Simulation *s = new Simulation(m_case, wxString::Format("Stochastic #%d", (int)(i + 1)));
 		m_sims.push_back(s);
 
+		// only keep the outputs selected for analysis
+		s->SetOutputFilter(output_vars);
+		s->SetBaseInputs(base_inputs);
+
 		for (size_t j = 0; j < m_sd.InputDistributions.size(); j++)
 		{
 			wxString iname(GetVarNameFromInputDistribution(m_sd.InputDistributions[j]));
@@ -2205,9 +2212,6 @@ void StochasticPanel::Simulate()
 				s->Override(iname, VarValue((double)m_input_data(i, j)));
 		}
 
-		if (!s->Prepare())
-			wxMessageBox(wxString::Format("internal error preparing simulation %d for stochastic", (int)(i + 1)));
-
 		tpd.Update(0, (float)i / (float)m_sd.N * 100.0f, wxString::Format("%d of %d", (int)(i + 1), (int)m_sd.N));
 
 		if (tpd.Canceled())
@@ -2229,13 +2233,13 @@ void StochasticPanel::Simulate()
 	size_t nok = 0;
 	if ( m_useThreads->GetValue() )
 	{
-		nok = Simulation::DispatchThreads( tpd, m_sims, nthread );
+		nok = Simulation::DispatchThreads( tpd, m_sims, nthread, true );
 	}
 	else
 	{
 		for( size_t i=0;i<m_sims.size();i++ )
 		{	
-			if( m_sims[i]->Invoke( true, false ) )
+			if( m_sims[i]->Invoke( true, true ) )
 				nok++;
 			
 			tpd.Update( 0, (float)i / (float)m_sd.N * 100.0f );
@@ -0,0 +1,67 @@
+/**
+BSD-3-Clause
+Copyright 2019 Alliance for Sustainable Energy, LLC
+Redistribution and use in source and binary forms, with or without modification, are permitted provided
+that the following conditions are met :
+1.	Redistributions of source code must retain the above copyright notice, this list of conditions
+and the following disclaimer.
+2.	Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+and the following disclaimer in the documentation and/or other materials provided with the distribution.
+3.	Neither the name of the copyright holder nor the names of its contributors may be used to endorse
+or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER, CONTRIBUTORS, UNITED STATES GOVERNMENT OR UNITED STATES
+DEPARTMENT OF ENERGY, NOR ANY OF THEIR EMPLOYEES, BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+OR CONSEQUENTIAL DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __symbols_h
+#define __symbols_h
+
+#include <vector>
+
+#include <wx/string.h>
+
+// equation inputs and outputs are interned once into dense integer ids
+// so that building and walking the equation graph indexes flat arrays
+// rather than hashing wide strings.
+// ids are process wide and are never reused or removed.
+typedef unsigned int SymbolId;
+#define SYMBOL_NONE ((SymbolId)-1)
+
+class SymbolTable
+{
+public:
+	// returns the id of the name, adding it if necessary
+	static SymbolId Intern( const wxString &name );
+	// returns SYMBOL_NONE if the name was never interned
+	static SymbolId Find( const wxString &name );
+};
+
+// flat array keyed by symbol id, ids never set return the default
+template< typename T >
+class SymbolMap
+{
+public:
+	SymbolMap( const T &def = T() ) : m_default( def ) { }
+
+	const T &Get( SymbolId id ) const { return id < m_items.size() ? m_items[id] : m_default; }
+	T &At( SymbolId id )
+	{
+		if ( id >= m_items.size() ) m_items.resize( id+1, m_default );
+		return m_items[id];
+	}
+	void Set( SymbolId id, const T &val ) { At( id ) = val; }
+	void Clear() { m_items.clear(); }
+
+private:
+	T m_default;
+	std::vector<T> m_items;
+};
+
+#endif
@@ -349,9 +349,9 @@ int UncertaintiesCtrl::Figure5(Simulation *sim)
 	// turbine curve
 
 	size_t ws_count=0;
-	double *ws=NULL;
+	const double *ws=NULL;
 	size_t tp_count=0;
-	double *tp=NULL;
+	const double *tp=NULL;
 	if (VarValue *vv = m_s->GetValue("wind_turbine_powercurve_windspeeds"))
 	{
 		ws = vv->Array(&ws_count);
@@ -382,7 +382,7 @@ int UncertaintiesCtrl::Figure5(Simulation *sim)
     std::vector<double> freq;
 	if (VarValue *vv = m_s->GetValue("wind_speed"))
 	{
-		wsb = vv->Array(&wsb_count);
+		wsb = const_cast<double*>( vv->Array(&wsb_count) ); // only read below
 		max_speed = *(std::max_element(wsb, wsb + wsb_count));
 		freq = util::frequency_table(wsb, wsb_count, bin_width);
 	}
@@ -678,7 +678,7 @@ int UncertaintiesCtrl::Display( Simulation *sim, Uncertainties &gi )
 		if (yvars[i]->Type() == VV_ARRAY)
 		{
 			size_t n = 0;
-			double *p = yvars[i]->Array(&n);
+			const double *p = yvars[i]->Array(&n);
 
 			plotdata[i].reserve(ndata);
 			for (size_t k = 0; k < n; k++)
@@ -750,7 +750,7 @@ int UncertaintiesCtrl::Display( Simulation *sim, Uncertainties &gi )
 					// Assume col[0] contains x values in order
 					// assume row[0] contains y values in order
 					size_t nx, ny;
-					double *data = vv->Matrix(&nx, &ny);
+					const double *data = vv->Matrix(&nx, &ny);
 					XX.Resize(nx - 1, ny - 1);
 					YY.Resize(nx - 1, ny - 1);
 					ZZ.Resize(nx - 1, ny - 1);
@@ -950,7 +950,7 @@ int UncertaintiesCtrl::Display(std::vector<Simulation *>sims, Uncertainties &gi)
 		if (yvars[i]->Type() == VV_ARRAY)
 		{
 			size_t n = 0;
-			double *p = yvars[i]->Array(&n);
+			const double *p = yvars[i]->Array(&n);
 
 			plotdata[i].reserve(ndata);
 			for (size_t k = 0; k < n; k++)
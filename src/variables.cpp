@@ -21,6 +21,10 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <cmath>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
 #include <numeric>
 #include <algorithm>
 
@@ -30,12 +34,15 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <wx/tokenzr.h>
 #include <wx/log.h>
 #include <wx/mstream.h>
+#include <wx/zstream.h>
+#include <wx/thread.h>
 #include <wx/filename.h>
 #include <wex/exttextstream.h>
 #include <lk/stdlib.h>
 #include <lk/eval.h>
 
 #include "variables.h"
+#include "mmapfile.h"
 
 // can place in utility
 // reference http://c-faq.com/fp/fpequal.html
@@ -313,7 +320,9 @@ VarTable::VarTable( ssc_data_t rhs)
         auto vd = ssc_data_lookup_case(rhs, key);
         if (!vd)
             vd = ssc_data_lookup(rhs, key);
-        Set(key, VarValue(vd));
+        // keys are unique in ssc data, so the value is built in place
+        // rather than built and then copied into the table
+        (*this)[ key ] = new VarValue(vd);
         key = ssc_data_next(rhs);
     }
 }
@@ -338,6 +347,8 @@ void VarTable::Copy( const VarTable &rhs )
 			it != rhs.end();
 			++it )
 			Set( it->first, *(it->second) );
+
+		m_base = rhs.m_base;
 	}
 }
 
@@ -359,6 +370,7 @@ void VarTable::clear()
 		delete it->second;
 
 	VarTableBase::clear();
+	m_base.reset();
 }
 
 bool VarTable::Delete( const wxString &name )
@@ -432,8 +444,40 @@ VarValue *VarTable::Set( const wxString &name, const VarValue &val )
 VarValue *VarTable::Get( const wxString &name )
 {
 	iterator it = find( name );
-	if ( it == end() ) return 0;
-	else return it->second;
+	if ( it != end() ) return it->second;
+	else if ( m_base ) return m_base->Get( name );
+	else return 0;
+}
+
+void VarTable::SetBase( std::shared_ptr<VarTable> base )
+{
+	m_base = base;
+}
+
+VarValue *VarTable::GetWritable( const wxString &name )
+{
+	iterator it = find( name );
+	if ( it != end() ) return it->second;
+
+	if ( m_base )
+		if ( VarValue *vv = m_base->Get( name ) )
+			return Set( name, *vv ); // copy on write
+
+	return 0;
+}
+
+void VarTable::Flatten()
+{
+	if ( !m_base ) return;
+
+	std::shared_ptr<VarTable> base( m_base );
+	m_base.reset();
+
+	// nearer layers take precedence, and shared bases are left untouched
+	for( VarTable *layer = base.get(); layer != 0; layer = layer->GetBase() )
+		for( iterator it = layer->begin(); it != layer->end(); ++it )
+			if ( find( it->first ) == end() )
+				(*this)[ it->first ] = new VarValue( *(it->second) );
 }
 
 bool VarTable::Rename( const wxString &old_name, const wxString &new_name )
@@ -496,8 +540,8 @@ void VarTable::Write( wxOutputStream &_O, size_t maxdim )
 				list.push_back( it->second );
 			}
 			else if ( vv.Type() == VV_MATRIX
-				&& vv.Matrix().nrows() <= maxdim
-				&& vv.Matrix().ncols() <= maxdim )
+				&& vv.Rows() <= maxdim
+				&& vv.Columns() <= maxdim )
 			{
 				names.Add( it->first );
 				list.push_back( it->second );
@@ -635,8 +679,8 @@ void VarTable::Write_text(wxOutputStream &_O, size_t maxdim)
 				list.push_back(it->second);
 			}
 			else if (vv.Type() == VV_MATRIX
-				&& vv.Matrix().nrows() <= maxdim
-				&& vv.Matrix().ncols() <= maxdim)
+				&& vv.Rows() <= maxdim
+				&& vv.Columns() <= maxdim)
 			{
 				names.Add(it->first);
 				list.push_back(it->second);
@@ -659,8 +703,8 @@ void VarTable::Write_text(wxOutputStream &_O, size_t maxdim)
 				&& vv.Length() <= maxdim)
 				names.Add(it->first);
 			else if (vv.Type() == VV_MATRIX
-				&& vv.Matrix().nrows() <= maxdim
-				&& vv.Matrix().ncols() <= maxdim)
+				&& vv.Rows() <= maxdim
+				&& vv.Columns() <= maxdim)
 				names.Add(it->first);
 			else if (vv.Type() != VV_MATRIX
 				&& vv.Type() != VV_ARRAY)
@@ -689,11 +733,266 @@ void VarTable::Write_text(wxOutputStream &_O, size_t maxdim)
 		}
 	}
 }
+// reads the format written by VarTable::Write_text directly from memory.
+// it follows the same word, line and character rules as the
+// wxExtTextInputStream reader below and builds identical tables, but
+// doesn't allocate a wxString per token
+class TextTableReader
+{
+public:
+	TextTableReader( const char *data, size_t len )
+		: m_p( data ), m_end( data + len )
+	{
+		// wxConvAuto skips a utf-8 byte order mark
+		if ( len >= 3 && (unsigned char)data[0] == 0xEF
+			&& (unsigned char)data[1] == 0xBB && (unsigned char)data[2] == 0xBF )
+			m_p += 3;
+	}
+
+	bool ReadTable( VarTable &tab )
+	{
+		tab.clear();
+
+		Uint(); // ver
+		size_t n = Uint();
+		for( size_t i=0;i<n;i++ )
+		{
+			wxString name = Name();
+
+			VarValue *value = new VarValue;
+			if ( !ReadValue( *value ) )
+			{
+				delete value;
+				return false;
+			}
+
+			if ( tab.find( name ) == tab.end() ) tab[name] = value;
+			else delete value;
+		}
+
+		return true;
+	}
+
+private:
+	const char *m_p, *m_end;
+
+	bool ReadValue( VarValue &vv )
+	{
+		Uint(); // ver
+		int type = (wxUint8)Uint();
+		size_t nr, nc, n;
+
+		vv.SetType( type );
+		switch( type )
+		{
+		default:
+		case VV_INVALID:
+			break;
+		case VV_NUMBER:
+		case VV_ARRAY:
+		case VV_MATRIX:
+			nr = Uint();
+			nc = Uint();
+			if ( nr*nc < 1 ) return false;
+			if ( nr*nc > 1 )
+			{
+				matrix_t<double> &mat = vv.WritableMatrix();
+				mat.resize_fill( nr, nc, 0.0 );
+				double *p = mat.data();
+				for( size_t r=0;r<nr;r++ )
+				{
+					const char *b, *e;
+					Line( &b, &e );
+					if ( !Row( b, e, p + r*nc, nc ) ) return false;
+				}
+			}
+			else if ( type == VV_NUMBER )
+				vv.Set( Real() );
+			else
+			{
+				matrix_t<double> &mat = vv.WritableMatrix();
+				mat.resize_fill( 1, 1, 0.0 );
+				mat(0,0) = Real();
+			}
+			break;
+		case VV_TABLE:
+			return ReadTable( vv.Table() );
+		case VV_STRING:
+			n = Uint();
+			vv.Set( Chars( n ) );
+			break;
+		case VV_BINARY:
+			{
+				n = Uint();
+				wxMemoryBuffer &bin = vv.Binary();
+				bin.SetBufSize( n );
+				bin.Clear();
+				for( size_t i=0;i<n;i++ )
+					bin.AppendByte( (char)Char() );
+			}
+			break;
+		case VV_DATMAT:
+		case VV_DATARR:
+			throw(std::runtime_error("Function not implemented for VV_DATARR AND VV_DATMAT"));
+		}
+
+		return true;
+	}
+
+	void SkipEol()
+	{
+		if ( m_p < m_end )
+		{
+			char c = *m_p++;
+			if ( c == '\r' && m_p < m_end && *m_p == '\n' ) m_p++;
+		}
+	}
+
+	// the next word, skipping blank lines. words end at a line break
+	void Word( const char **b, const char **e )
+	{
+		while ( m_p < m_end && ( *m_p == '\n' || *m_p == '\r' ) ) m_p++;
+		Line( b, e );
+	}
+
+	// the rest of the current line
+	void Line( const char **b, const char **e )
+	{
+		*b = m_p;
+		while ( m_p < m_end && *m_p != '\n' && *m_p != '\r' ) m_p++;
+		*e = m_p;
+		SkipEol();
+	}
+
+	// copies a token so the c library can parse it, tokens are short
+	static const char *Terminate( const char *b, const char *e, char *buf, size_t size, std::string &big )
+	{
+		size_t len = e - b;
+		if ( len < size )
+		{
+			memcpy( buf, b, len );
+			buf[len] = 0;
+			return buf;
+		}
+		big.assign( b, len );
+		return big.c_str();
+	}
+
+	wxUint32 Uint()
+	{
+		const char *b, *e;
+		Word( &b, &e );
+		if ( b == e ) return 0;
+		char buf[64];
+		std::string big;
+		return (wxUint32)strtoul( Terminate( b, e, buf, sizeof(buf), big ), 0, 10 );
+	}
+
+	double Real()
+	{
+		const char *b, *e;
+		Word( &b, &e );
+		if ( b == e ) return 0;
+		char buf[64];
+		std::string big;
+		return strtod( Terminate( b, e, buf, sizeof(buf), big ), 0 );
+	}
+
+	// space separated values that must each parse completely, as with
+	// wxStringTokenize() and wxString::ToDouble()
+	static bool Row( const char *b, const char *e, double *p, size_t nc )
+	{
+		size_t count = 0;
+		char buf[64];
+		std::string big;
+		while ( b < e )
+		{
+			while ( b < e && *b == ' ' ) b++;
+			if ( b == e ) break;
+
+			const char *t = b;
+			while ( b < e && *b != ' ' ) b++;
+			if ( count >= nc ) return false;
+
+			const char *s = Terminate( t, b, buf, sizeof(buf), big );
+			char *end = 0;
+			errno = 0;
+			double y = strtod( s, &end );
+			if ( *end != 0 || end == s || errno == ERANGE ) return false;
+			p[count++] = y;
+		}
+		return count == nc;
+	}
+
+	// one utf-8 character, bytes that aren't valid utf-8 are taken as latin-1
+	wxUint32 Char()
+	{
+		if ( m_p >= m_end ) return 0;
+
+		unsigned char c = (unsigned char)*m_p;
+		size_t len = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 0;
+		if ( len == 1 || len == 0 || m_p + len > m_end )
+		{
+			m_p++;
+			return c;
+		}
+
+		wxUint32 code = c & ( 0xFF >> (len+1) );
+		for( size_t i=1;i<len;i++ )
+		{
+			unsigned char cc = (unsigned char)m_p[i];
+			if ( (cc & 0xC0) != 0x80 )
+			{
+				m_p++;
+				return c;
+			}
+			code = (code << 6) | (cc & 0x3F);
+		}
+		m_p += len;
+		return code;
+	}
+
+	wxString Name()
+	{
+		const char *b, *e;
+		Word( &b, &e );
+		wxString name = wxString::FromUTF8( b, e-b );
+		if ( name.IsEmpty() && b != e )
+		{
+			// not valid utf-8, decode it the same way as Chars()
+			const char *next = m_p;
+			m_p = b;
+			while ( m_p < e ) name.Append( wxUniChar( Char() ) );
+			m_p = next;
+		}
+		return name;
+	}
+
+	wxString Chars( size_t n )
+	{
+		// plain ascii is converted in one step
+		const char *b = m_p;
+		size_t i = 0;
+		while ( i < n && m_p < m_end && (unsigned char)*m_p < 0x80 )
+		{
+			m_p++;
+			i++;
+		}
+
+		wxString str = wxString::FromAscii( b, m_p - b );
+		for( ;i<n;i++ )
+			str.Append( wxUniChar( Char() ) );
+		return str;
+	}
+};
+
 bool VarTable::Read_text(const wxString &file)
 {
-	wxFFileInputStream in(file);
-	if (!in.IsOk()) return false;
-	else return Read_text(in);
+	MappedFile mf;
+	if (!mf.Open(file)) return false;
+
+	TextTableReader reader(mf.Data(), mf.Size());
+	return reader.ReadTable(*this);
 }
 
 bool VarTable::Read_text(wxInputStream &_I)
@@ -727,88 +1026,126 @@ bool VarTable::Read_text(wxInputStream &_I)
 
 bool VarTable::AsSSCData(ssc_data_t p_dat) {
     ssc_data_clear(p_dat);
-    ssc_var_t entry = ssc_var_create();
     for( auto it = begin(); it != end(); ++it )
     {
-        if (!it->second->AsSSCVar(entry))
+        if (!it->second->AssignSSCData(p_dat, it->first.c_str()))
             return false;
-        ssc_data_set_var(p_dat, it->first.c_str(), entry);
     }
-    ssc_var_free(entry);
     return true;
 }
 
+// numeric payloads are shared between copies of a value and only
+// duplicated when one of them is modified
+struct VarValue::SharedMatrix
+{
+	SharedMatrix() : refs( 1 ), pending( false ), best_codec( -1 ) { }
+	SharedMatrix( const matrix_t<double> &m ) : refs( 1 ), mat( m ), pending( false ), best_codec( -1 ) { }
+
+	size_t Rows() const { return pending ? nr : mat.nrows(); }
+	size_t Cols() const { return pending ? nc : mat.ncols(); }
+	void Defer( std::shared_ptr<LargeValueSource> src, wxUint64 off, wxUint64 len, int cod, size_t r, size_t c );
+	void Load();
+	bool CopyPending( LargeValueWriter &large, wxUint64 *new_offset );
+	void Discard();
+	int Codec();
+
+	std::atomic<int> refs;
+	matrix_t<double> mat;
+
+	// set while the payload is still out of line in a project archive
+	std::atomic<bool> pending;
+	std::shared_ptr<LargeValueSource> source;
+	wxUint64 offset, length;
+	int codec;
+	size_t nr, nc;
+
+	// encoding picked for the stream, -1 until chosen or after a write
+	std::atomic<int> best_codec;
+};
+
 VarValue VarValue::Invalid; // declaration
 
 VarValue::VarValue()
 {
 	m_type = VV_INVALID;
+	m_store = VS_NONE;
 }
 
 
 VarValue::VarValue( const VarValue &vv )
 {
+	m_type = VV_INVALID;
+	m_store = VS_NONE;
 	Copy( vv );
 }
 
+VarValue::VarValue( VarValue &&vv ) noexcept
+{
+	m_type = vv.m_type;
+	m_store = vv.m_store;
+	m_data = vv.m_data;
+	vv.m_type = VV_INVALID;
+	vv.m_store = VS_NONE;
+}
+
 VarValue::VarValue( int i )
 {
-	m_type = VV_NUMBER;
-	m_val = (float)i;
+	m_store = VS_NONE;
+	Set( i );
 }
 
 VarValue::VarValue( double f )
 {
-	m_type = VV_NUMBER;
-	m_val = f;
+	m_store = VS_NONE;
+	Set( f );
 }
 
 VarValue::VarValue( bool b )
 {
-	m_type = VV_NUMBER;
-	m_val = b ? 1 : 0;
+	m_store = VS_NONE;
+	Set( b ? 1.0 : 0.0 );
 }
 
 VarValue::VarValue( const std::vector<double> &f )
 {
-	m_type = VV_ARRAY;
-	if ( f.size() > 0 ) m_val.assign( &f[0], f.size() );
+	m_store = VS_NONE;
+	Set( f );
 }
 
 VarValue::VarValue( double *arr, size_t n )
 {
-	m_type = VV_ARRAY;
-	m_val.assign( arr, n );
+	m_store = VS_NONE;
+	Set( arr, n );
 }
 
 VarValue::VarValue( double *mat, size_t r, size_t c )
 {
-	m_type = VV_MATRIX;
-	m_val.assign( mat, r, c );
+	m_store = VS_NONE;
+	Set( mat, r, c );
 }
 
 VarValue::VarValue( const matrix_t<double> &m )
 {
-	m_type = VV_MATRIX;
-	m_val = m;
+	m_store = VS_NONE;
+	Set( m );
 }
 
 VarValue::VarValue( const wxString &s )
 {
-	m_type = VV_STRING;
-	m_str = s;
+	m_store = VS_NONE;
+	Set( s );
 }
 
 VarValue::VarValue( const VarTable &t )
 {
-	m_type = VV_TABLE;
-	m_tab.Copy( t );
+	m_store = VS_NONE;
+	Set( t );
 }
 
 VarValue::VarValue( const wxMemoryBuffer &mb )
 {
-	m_type = VV_BINARY;
-	m_bin = mb;
+	m_store = VS_NONE;
+	Set( mb );
 }
 
 typedef double ssc_number_t;
@@ -816,6 +1153,7 @@ typedef double ssc_number_t;
 VarValue::VarValue(ssc_var_t vd) {
     int n, m;
     ssc_number_t* arr;
+    m_store = VS_NONE;
     int type = ssc_var_query(vd);
     switch(type){
         default:
@@ -823,169 +1161,852 @@ VarValue::VarValue(ssc_var_t vd) {
             m_type = VV_INVALID;
             break;
         case SSC_STRING :
-            m_type = VV_STRING;
-            m_str = ssc_var_get_string(vd);
+            Set( wxString(ssc_var_get_string(vd)) );
             break;
         case SSC_NUMBER :
-            m_type = VV_NUMBER;
-            m_val = ssc_var_get_number(vd);\
+            Set( (double)ssc_var_get_number(vd) );
             break;
         case SSC_ARRAY :
-            m_type = VV_ARRAY;
             arr = ssc_var_get_array(vd, &n);
-            m_val.assign(arr, n);
+            Set(arr, (size_t)n);
             break;
         case SSC_MATRIX :
-            m_type = VV_MATRIX;
             arr = ssc_var_get_matrix(vd, &n, &m);
-            m_val.assign(arr, n, m);
+            Set(arr, (size_t)n, (size_t)m);
             break;
         case SSC_TABLE :
             m_type = VV_TABLE;
-            m_tab = VarTable(ssc_var_get_table(vd));
+            m_data.table = new VarTable(ssc_var_get_table(vd));
+            m_store = VS_TABLE;
             break;
         case SSC_DATARR : {
             m_type = VV_DATARR;
+            std::vector<VarValue> &datarr = DatArr();
             ssc_var_size(vd, &n, nullptr);
+            datarr.reserve(n);
             for (int i = 0; i < n; i++) {
-                m_datarr.emplace_back(VarValue(ssc_var_get_var_array(vd, i)));
+                datarr.emplace_back(ssc_var_get_var_array(vd, i));
             }
             break;
         }
-        case SSC_DATMAT :
+        case SSC_DATMAT : {
             m_type = VV_DATMAT;
+            std::vector<std::vector<VarValue>> &datmat = DatMat();
             ssc_var_size(vd, &n, &m);
+            datmat.reserve(n);
             for (int i = 0; i < n; i++){
                 std::vector<VarValue> row;
+                row.reserve(m);
                 for (int j = 0; j < m; j++)
-                    row.emplace_back(VarValue(ssc_var_get_var_matrix(vd, i, j)));
-                m_datmat.emplace_back(row);
+                    row.emplace_back(ssc_var_get_var_matrix(vd, i, j));
+                datmat.emplace_back(std::move(row));
             }
             break;
+        }
+    }
+}
+
+
+VarValue::~VarValue()
+{
+	Release();
+}
+
+VarValue &VarValue::operator=( const VarValue &rhs )
+{
+	Copy( rhs );
+	return *this;
+}
+
+VarValue &VarValue::operator=( VarValue &&rhs ) noexcept
+{
+	if ( this != &rhs )
+	{
+		// rhs may be held in this value's own payload, so release it last
+		VarValue old( std::move( *this ) );
+		m_type = rhs.m_type;
+		m_store = rhs.m_store;
+		m_data = rhs.m_data;
+		rhs.m_type = VV_INVALID;
+		rhs.m_store = VS_NONE;
+	}
+	return *this;
+}
+
+void VarValue::Release()
+{
+	switch( m_store )
+	{
+	case VS_MATRIX: if ( --m_data.matrix->refs == 0 ) delete m_data.matrix; break;
+	case VS_STRING: delete m_data.string; break;
+	case VS_TABLE: delete m_data.table; break;
+	case VS_BINARY: delete m_data.binary; break;
+	case VS_DATARR: delete m_data.datarr; break;
+	case VS_DATMAT: delete m_data.datmat; break;
+	}
+	m_store = VS_NONE;
+}
+
+void VarValue::StoreNumber( double val )
+{
+	Release();
+	m_data.number = val;
+	m_store = VS_NUMBER;
+}
+
+void VarValue::StoreString( const wxString &str )
+{
+	// short plain ascii strings are kept inline, they convert the same
+	// way under any locale so c_str() users see identical bytes
+	char buf[SHORTSTR_LEN+1];
+	size_t len = 0;
+	bool inline_ok = str.Len() <= SHORTSTR_LEN;
+	for( wxString::const_iterator it = str.begin(); inline_ok && it != str.end(); ++it )
+	{
+		wxUint32 c = (*it).GetValue();
+		if ( c == 0 || c > 0x7f ) inline_ok = false;
+		else buf[len++] = (char)c;
+	}
+
+	if ( inline_ok )
+	{
+		buf[len] = 0;
+		Release();
+		memcpy( m_data.shortstr, buf, len+1 );
+		m_store = VS_SHORTSTR;
+	}
+	else if ( m_store == VS_STRING )
+		*m_data.string = str;
+	else
+	{
+		wxString *copy = new wxString( str );
+		Release();
+		m_data.string = copy;
+		m_store = VS_STRING;
+	}
+}
+
+double VarValue::StoredNumber()
+{
+	if ( m_store == VS_NUMBER ) return m_data.number;
+	else if ( m_store == VS_MATRIX )
+	{
+		m_data.matrix->Load();
+		return (double)m_data.matrix->mat;
+	}
+	else return 0.0;
+}
+
+wxString VarValue::StoredString()
+{
+	if ( m_store == VS_SHORTSTR ) return wxString::FromAscii( m_data.shortstr );
+	else if ( m_store == VS_STRING ) return *m_data.string;
+	else return wxEmptyString;
+}
+
+size_t VarValue::NumRows()
+{
+	if ( m_store == VS_MATRIX ) return m_data.matrix->Rows();
+	else if ( m_store == VS_NUMBER ) return 1;
+	else return 0;
+}
+
+size_t VarValue::NumCols()
+{
+	if ( m_store == VS_MATRIX ) return m_data.matrix->Cols();
+	else if ( m_store == VS_NUMBER ) return 1;
+	else return 0;
+}
+
+double *VarValue::NumData()
+{
+	if ( m_store == VS_MATRIX )
+	{
+		m_data.matrix->Load();
+		return m_data.matrix->mat.data();
+	}
+	else if ( m_store == VS_NUMBER ) return &m_data.number;
+	else return 0;
+}
+
+matrix_t<double> &VarValue::Mat()
+{
+	if ( m_store == VS_MATRIX )
+	{
+		m_data.matrix->Load();
+
+		// copy on the first write through a shared buffer
+		if ( m_data.matrix->refs > 1 )
+		{
+			SharedMatrix *copy = new SharedMatrix( m_data.matrix->mat );
+			Release();
+			m_data.matrix = copy;
+			m_store = VS_MATRIX;
+		}
+	}
+	else
+	{
+		// an inline number becomes the single element of the matrix
+		SharedMatrix *mat = new SharedMatrix;
+		if ( m_store == VS_NUMBER ) mat->mat = m_data.number;
+		Release();
+		m_data.matrix = mat;
+		m_store = VS_MATRIX;
+	}
+	m_data.matrix->best_codec = -1;
+	return m_data.matrix->mat;
+}
+
+matrix_t<double> &VarValue::NewMat()
+{
+	// the contents are about to be replaced, so don't copy a shared buffer
+	if ( m_store != VS_MATRIX || m_data.matrix->refs > 1 )
+	{
+		SharedMatrix *mat = new SharedMatrix;
+		Release();
+		m_data.matrix = mat;
+		m_store = VS_MATRIX;
+	}
+	else
+		m_data.matrix->Discard();
+	m_data.matrix->best_codec = -1;
+	return m_data.matrix->mat;
+}
+
+VarTable &VarValue::Tab()
+{
+	if ( m_store != VS_TABLE )
+	{
+		VarTable *tab = new VarTable;
+		Release();
+		m_data.table = tab;
+		m_store = VS_TABLE;
+	}
+	return *m_data.table;
+}
+
+wxMemoryBuffer &VarValue::Bin()
+{
+	if ( m_store != VS_BINARY )
+	{
+		wxMemoryBuffer *bin = new wxMemoryBuffer;
+		Release();
+		m_data.binary = bin;
+		m_store = VS_BINARY;
+	}
+	return *m_data.binary;
+}
+
+std::vector<VarValue> &VarValue::DatArr()
+{
+	if ( m_store != VS_DATARR )
+	{
+		std::vector<VarValue> *datarr = new std::vector<VarValue>;
+		Release();
+		m_data.datarr = datarr;
+		m_store = VS_DATARR;
+	}
+	return *m_data.datarr;
+}
+
+std::vector<std::vector<VarValue>> &VarValue::DatMat()
+{
+	if ( m_store != VS_DATMAT )
+	{
+		std::vector<std::vector<VarValue>> *datmat = new std::vector<std::vector<VarValue>>;
+		Release();
+		m_data.datmat = datmat;
+		m_store = VS_DATMAT;
+	}
+	return *m_data.datmat;
+}
+
+
+bool VarValue::ValueEqual( VarValue &rhs )
+{
+	bool equal = false;
+	if (m_type == rhs.m_type)
+	{
+		std::vector<VarValue*> vv_vec1, vv_vec2;
+		switch (m_type)
+		{
+		case VV_INVALID: // this and rhs are both invalid
+			equal = true;
+			break;
+		case VV_NUMBER:
+		case VV_ARRAY:
+		case VV_MATRIX:
+			equal = ((NumRows() == rhs.NumRows()) && (NumCols() == rhs.NumCols()));
+			if (equal)
+			{
+				double *p1 = NumData();
+				double *p2 = rhs.NumData();
+				size_t n = NumRows() * NumCols();
+				for (size_t i = 0; i < n && equal; i++)
+				{
+					double x = p1[i];
+					double y = p2[i];
+					if ((std::isnan(x)) || (std::isnan(y)))
+						equal = ((std::isnan(x)) && (std::isnan(y)));
+					else if ((std::isinf(x)) || (std::isinf(y)))
+						equal = ((std::isinf(x)) && (std::isinf(y)));
+					else
+						equal = (RelDif(x, y) < TOLERANCE);
+				}
+			}
+			break;
+		case VV_TABLE: // not working correctly
+			equal = (Tab().size() == rhs.Tab().size());
+			if (equal)
+				for (VarTable::iterator it1 = Tab().begin(); it1 != Tab().end(); ++it1)
+				{
+					if (VarValue *vv = rhs.Tab().Get(it1->first))
+						equal = equal && (it1->second->ValueEqual(*vv));
+					else
+					{
+						equal = false;
+						break;
+					}
+				}
+			break;
+		case VV_STRING:
+			equal = (StoredString() == rhs.StoredString());
+			break;
+		case VV_BINARY:
+			if ( Bin().GetDataLen() == rhs.Bin().GetDataLen() )
+			{
+				equal = true;
+				size_t n = Bin().GetDataLen();
+				char *b1 = (char*)Bin().GetData();
+				char *b2 = (char*)rhs.Bin().GetData();
+				for( size_t i=0;i<n;i++ )
+				{
+					if ( b1[i] != b2[i] )
+					{
+						equal = false;
+						break;
+					}
+				}
+			}
+			else
+				equal = false;
+			break;
+		    case VV_DATARR:
+		        break;
+		    case VV_DATMAT:
+		        break;
+		}
+	}
+	return equal;
+}
+
+bool VarValue::Identical( VarValue &rhs )
+{
+	if ( m_type != rhs.m_type ) return false;
+	if ( SharesData( rhs ) ) return true;
+
+	switch( m_type )
+	{
+	case VV_INVALID:
+		return true;
+	case VV_NUMBER:
+	case VV_ARRAY:
+	case VV_MATRIX:
+	{
+		if ( NumRows() != rhs.NumRows() || NumCols() != rhs.NumCols() ) return false;
+		size_t n = NumRows() * NumCols();
+		if ( n == 0 ) return true;
+		double *p1 = NumData();
+		double *p2 = rhs.NumData();
+		return p1 != 0 && p2 != 0 && memcmp( p1, p2, n*sizeof(double) ) == 0;
+	}
+	case VV_STRING:
+		return StoredString() == rhs.StoredString();
+	case VV_BINARY:
+		return Bin().GetDataLen() == rhs.Bin().GetDataLen()
+			&& ( Bin().GetDataLen() == 0
+				|| memcmp( Bin().GetData(), rhs.Bin().GetData(), Bin().GetDataLen() ) == 0 );
+	}
+
+	return false;
+}
+
+void VarValue::Copy( const VarValue &rhs )
+{
+	if ( this != &rhs )
+	{
+		// rhs may be held in this value's own table or data array,
+		// so the old payload is only released after the copy is made
+		VarValue old( std::move( *this ) );
+
+		m_type = rhs.m_type;
+		switch( rhs.m_store )
+		{
+		case VS_NUMBER:
+			m_data.number = rhs.m_data.number;
+			break;
+		case VS_SHORTSTR:
+			memcpy( m_data.shortstr, rhs.m_data.shortstr, sizeof(m_data.shortstr) );
+			break;
+		case VS_MATRIX:
+			m_data.matrix = rhs.m_data.matrix;
+			m_data.matrix->refs++;
+			break;
+		case VS_STRING:
+			m_data.string = new wxString( *rhs.m_data.string );
+			break;
+		case VS_TABLE:
+			m_data.table = new VarTable( *rhs.m_data.table );
+			break;
+		case VS_BINARY:
+			// wxMemeoryBuffer is not a copy on write so causing issues bewtween cases, e.g. shade_scen_3d
+			m_data.binary = new wxMemoryBuffer( rhs.m_data.binary->GetDataLen() );
+			m_data.binary->AppendData( rhs.m_data.binary->GetData(), rhs.m_data.binary->GetDataLen() );
+			break;
+		case VS_DATARR:
+			m_data.datarr = new std::vector<VarValue>( *rhs.m_data.datarr );
+			break;
+		case VS_DATMAT:
+			m_data.datmat = new std::vector<std::vector<VarValue>>( *rhs.m_data.datmat );
+			break;
+		}
+		m_store = rhs.m_store;
+
+        // UI hints?
     }
 }
 
 
-VarValue::~VarValue()
+// since stream version 3 numeric payloads are one contiguous block of
+// little-endian doubles rather than a WriteDouble() call per element
+static void write_double_block( wxOutputStream &os, double *p, size_t n )
+{
+#if wxBYTE_ORDER == wxBIG_ENDIAN
+	std::vector<wxUint64> buf( n );
+	memcpy( &buf[0], p, n*sizeof(double) );
+	for( size_t i=0;i<n;i++ )
+		buf[i] = wxUINT64_SWAP_ALWAYS( buf[i] );
+	os.Write( &buf[0], n*sizeof(double) );
+#else
+	os.Write( p, n*sizeof(double) );
+#endif
+}
+
+static bool read_double_block( wxInputStream &is, double *p, size_t n )
+{
+	is.Read( p, n*sizeof(double) );
+	if ( is.LastRead() != n*sizeof(double) ) return false;
+#if wxBYTE_ORDER == wxBIG_ENDIAN
+	wxUint64 *u = (wxUint64*)p;
+	for( size_t i=0;i<n;i++ )
+		u[i] = wxUINT64_SWAP_ALWAYS( u[i] );
+#endif
+	return true;
+}
+
+// since stream version 4 each numeric payload is preceded by its encoding.
+// a long series may be written with its bytes grouped by significance, which
+// turns the shared sign and exponent bytes of neighbouring values into long
+// runs for the project's zlib stream, optionally after xor-ing each value with
+// the one before it, which pays off for smooth sub-hourly series.  neither
+// wins for every hourly series, so the writer deflates a sample each way
+// and keeps the smallest
+enum { NUMERIC_RAW = 0, NUMERIC_SHUFFLE = 1, NUMERIC_XOR_SHUFFLE = 2, NUMERIC_LARGE_VALUE = 3 };
+#define NUMERIC_SERIES_MIN_LEN 256
+#define LARGE_VALUE_MIN_LEN 2048
+#define NUMERIC_SAMPLE_LEN 2048
+
+static void shuffle_encode( const double *p, size_t n, bool xor_prev, std::vector<unsigned char> &buf )
+{
+	std::vector<wxUint64> words( n );
+	memcpy( &words[0], p, n*sizeof(double) );
+	if ( xor_prev )
+		for( size_t i=n-1;i>0;i-- )
+			words[i] ^= words[i-1];
+
+	buf.resize( n*8 );
+	for( size_t b=0;b<8;b++ )
+	{
+		unsigned char *group = &buf[b*n];
+		for( size_t i=0;i<n;i++ )
+			group[i] = (unsigned char)( words[i] >> (8*b) );
+	}
+}
+
+static void shuffle_decode( const unsigned char *buf, size_t n, bool xor_prev, double *p )
+{
+	std::vector<wxUint64> words( n, 0 );
+	for( size_t b=0;b<8;b++ )
+	{
+		const unsigned char *group = &buf[b*n];
+		for( size_t i=0;i<n;i++ )
+			words[i] |= ((wxUint64)group[i]) << (8*b);
+	}
+	if ( xor_prev )
+		for( size_t i=1;i<n;i++ )
+			words[i] ^= words[i-1];
+	memcpy( p, &words[0], n*sizeof(double) );
+}
+
+static size_t deflated_size( const void *data, size_t len )
+{
+	wxCountingOutputStream count;
+	{
+		wxZlibOutputStream zout( count, 1 );
+		zout.Write( data, len );
+		zout.Close();
+	}
+	return (size_t)count.GetLength();
+}
+
+static int choose_numeric_codec( const double *p, size_t n )
+{
+	if ( n < NUMERIC_SERIES_MIN_LEN ) return NUMERIC_RAW;
+
+	size_t ns = n < NUMERIC_SAMPLE_LEN ? n : NUMERIC_SAMPLE_LEN;
+	int best = NUMERIC_RAW;
+	size_t best_len = deflated_size( p, ns*sizeof(double) );
+
+	std::vector<unsigned char> buf;
+	for( int codec = NUMERIC_SHUFFLE; codec <= NUMERIC_XOR_SHUFFLE; codec++ )
+	{
+		shuffle_encode( p, ns, codec == NUMERIC_XOR_SHUFFLE, buf );
+		size_t len = deflated_size( &buf[0], buf.size() );
+		if ( len < best_len )
+		{
+			best = codec;
+			best_len = len;
+		}
+	}
+	return best;
+}
+
+int VarValue::SharedMatrix::Codec()
+{
+	// trial compression is too slow to repeat on every save, so it runs
+	// once per payload and holds until the payload is written to
+	Load();
+	int c = best_codec;
+	if ( c < 0 )
+	{
+		c = choose_numeric_codec( mat.data(), mat.length() );
+		best_codec = c;
+	}
+	return c;
+}
+
+static void write_numeric_block( wxOutputStream &os, int codec, double *p, size_t n )
+{
+	if ( codec == NUMERIC_RAW )
+		write_double_block( os, p, n );
+	else
+	{
+		std::vector<unsigned char> buf;
+		shuffle_encode( p, n, codec == NUMERIC_XOR_SHUFFLE, buf );
+		os.Write( &buf[0], buf.size() );
+	}
+}
+
+static bool read_numeric_block( wxInputStream &is, int codec, double *p, size_t n )
+{
+	if ( codec == NUMERIC_RAW )
+		return read_double_block( is, p, n );
+	else if ( codec != NUMERIC_SHUFFLE && codec != NUMERIC_XOR_SHUFFLE )
+		return false;
+
+	std::vector<unsigned char> buf( n*8 );
+	is.Read( &buf[0], n*8 );
+	if ( is.LastRead() != n*8 ) return false;
+	shuffle_decode( &buf[0], n, codec == NUMERIC_XOR_SHUFFLE, p );
+	return true;
+}
+
+// sources are kept in a list so that a file can be released before
+// it is overwritten, and the lock also serializes loading payloads
+static wxMutex gs_largeValueLock;
+static std::vector<LargeValueSource*> gs_largeValueSources;
+static thread_local LargeValueWriter *gs_largeValueWriter = 0;
+static thread_local LargeValueReader *gs_largeValueReader = 0;
+static thread_local int gs_numericEncoding = 0;
+
+LargeValueSource::LargeValueSource()
+{
+	m_map = new MappedFile;
+	wxMutexLocker _lock( gs_largeValueLock );
+	gs_largeValueSources.push_back( this );
+}
+
+LargeValueSource::~LargeValueSource()
+{
+	{
+		wxMutexLocker _lock( gs_largeValueLock );
+		gs_largeValueSources.erase( std::find( gs_largeValueSources.begin(), gs_largeValueSources.end(), this ) );
+	}
+	delete m_map;
+}
+
+bool LargeValueSource::Open( const wxString &file )
+{
+	wxMutexLocker _lock( gs_largeValueLock );
+	m_file = file;
+	return m_map->Open( file );
+}
+
+const char *LargeValueSource::Data() const { return m_map->Data(); }
+size_t LargeValueSource::Size() const { return m_map->Size(); }
+
+bool LargeValueSource::Load( wxUint64 offset, wxUint64 length, int codec, double *p, size_t n )
+{
+	if ( offset + length > m_map->Size() ) return false;
+	wxMemoryInputStream mem( m_map->Data() + offset, (size_t)length );
+	wxZlibInputStream zin( mem );
+	return read_numeric_block( zin, codec, p, n );
+}
+
+bool LargeValueSource::InUse( const wxString &file )
+{
+	wxFileName fn( file );
+	wxMutexLocker _lock( gs_largeValueLock );
+	for( size_t i=0;i<gs_largeValueSources.size();i++ )
+		if ( fn.SameAs( wxFileName( gs_largeValueSources[i]->m_file ) ) )
+			return true;
+	return false;
+}
+
+void LargeValueSource::Detach( const wxString &file )
+{
+	wxFileName fn( file );
+	wxMutexLocker _lock( gs_largeValueLock );
+	for( size_t i=0;i<gs_largeValueSources.size();i++ )
+		if ( fn.SameAs( wxFileName( gs_largeValueSources[i]->m_file ) ) )
+			gs_largeValueSources[i]->m_map->Detach();
+}
+
+LargeValueWriter::LargeValueWriter( wxOutputStream &os )
+	: m_os( os ), m_prev( gs_largeValueWriter )
+{
+	gs_largeValueWriter = this;
+}
+
+LargeValueWriter::~LargeValueWriter()
+{
+	gs_largeValueWriter = m_prev;
+}
+
+LargeValueWriter *LargeValueWriter::Current()
+{
+	return gs_largeValueWriter;
+}
+
+bool LargeValueWriter::Put( int codec, double *p, size_t n, wxUint64 *offset, wxUint64 *length )
+{
+	*offset = (wxUint64)m_os.TellO();
+	{
+		wxZlibOutputStream zout( m_os );
+		write_numeric_block( zout, codec, p, n );
+		zout.Close();
+	}
+	*length = (wxUint64)m_os.TellO() - *offset;
+	return m_os.IsOk();
+}
+
+bool LargeValueWriter::Copy( const char *data, wxUint64 length, wxUint64 *offset )
+{
+	*offset = (wxUint64)m_os.TellO();
+	m_os.Write( data, (size_t)length );
+	return m_os.IsOk();
+}
+
+NumericEncodingScope::NumericEncodingScope()
 {
-	// Nothing to do
+	gs_numericEncoding++;
 }
 
-VarValue &VarValue::operator=( const VarValue &rhs )
+NumericEncodingScope::~NumericEncodingScope()
 {
-	Copy( rhs );
-	return *this;
+	gs_numericEncoding--;
 }
 
+bool NumericEncodingScope::Active()
+{
+	return gs_numericEncoding > 0 || gs_largeValueWriter != 0;
+}
 
-bool VarValue::ValueEqual( VarValue &rhs )
+LargeValueReader::LargeValueReader( std::shared_ptr<LargeValueSource> src )
+	: m_src( src ), m_prev( gs_largeValueReader )
 {
-	bool equal = false;
-	if (m_type == rhs.m_type)
+	gs_largeValueReader = this;
+}
+
+LargeValueReader::~LargeValueReader()
+{
+	gs_largeValueReader = m_prev;
+}
+
+std::shared_ptr<LargeValueSource> LargeValueReader::Current()
+{
+	if ( gs_largeValueReader ) return gs_largeValueReader->m_src;
+	else return std::shared_ptr<LargeValueSource>();
+}
+
+bool LargeValueArchive::WriteArchive( const wxString &file )
+{
+	// values may still be loading lazily from the file being replaced,
+	// so write next to it and swap the new file in at the end
+	bool replace = LargeValueSource::InUse( file );
+	wxString target = replace ? file + ".tmp" : file;
+
+	bool ok = false;
 	{
-		std::vector<VarValue*> vv_vec1, vv_vec2;
-		switch (m_type)
+		wxFFileOutputStream out( target );
+		if ( ! out.IsOk() ) return false;
+
+		// write two bytes of uncompressed identifiers
+		wxUint8 code = 0x41;
+		out.Write( &code, 1 );
+		code = 0xb9;
+		out.Write( &code, 1 );
+
+		// write one byte to indicate compression format:
+		// zlib (=1), or zlib with large arrays and matrices stored
+		// out of line as separately compressed blocks (=2)
+		code = 2;
+		out.Write( &code, 1 );
+
+		// the offset of the main stream follows the large values
+		wxDataOutputStream dout( out );
+		dout.Write64( (wxUint64)0 );
+
+		wxMemoryOutputStream main;
 		{
-		case VV_INVALID: // this and rhs are both invalid
-			equal = true;
-			break;
-		case VV_NUMBER:
-		case VV_ARRAY:
-		case VV_MATRIX:
-			equal = ((m_val.nrows() == rhs.m_val.nrows()) && (m_val.ncols() == rhs.m_val.ncols()));
-			if (equal)
-				for (size_t r = 0; r < m_val.nrows(); r++)
-					for (size_t c = 0; c < m_val.ncols(); c++)
-					  {
-						if (equal)
-						{
-							double x = m_val(r, c);
-							double y = rhs.m_val(r, c);
-							if ((std::isnan(x)) || (std::isnan(y)))
-								equal = ((std::isnan(x)) && (std::isnan(y)));
-							else if ((std::isinf(x)) || (std::isinf(y)))
-								equal = ((std::isinf(x)) && (std::isinf(y)));
-							else
-								equal = (RelDif(m_val(r, c), rhs.m_val(r, c)) < TOLERANCE);
-						}
-						else
-							break;
-					  }
-			break;
-		case VV_TABLE: // not working correctly
-			equal = (m_tab.size() == rhs.m_tab.size());
-			if (equal)
-				for (VarTable::iterator it1 = m_tab.begin(); it1 != m_tab.end(); ++it1)
-				{
-					if (VarValue *vv = rhs.m_tab.Get(it1->first))
-						equal = equal && (it1->second->ValueEqual(*vv));
-					else
-					{
-						equal = false;
-						break;
-					}
-				}
-			break;
-		case VV_STRING:
-			equal = (m_str == rhs.m_str);
-			break;
-		case VV_BINARY:
-			if ( m_bin.GetDataLen() == rhs.m_bin.GetDataLen() )
-			{
-				equal = true;
-				size_t n = m_bin.GetDataLen();
-				char *b1 = (char*)m_bin.GetData();
-				char *b2 = (char*)rhs.m_bin.GetData();
-				for( size_t i=0;i<n;i++ )
-				{
-					if ( b1[i] != b2[i] )
-					{
-						equal = false;
-						break;
-					}
-				}
-			}
-			else
-				equal = false;
-			break;
-		    case VV_DATARR:
-		        break;
-		    case VV_DATMAT:
-		        break;
+			LargeValueWriter large( out );
+			wxZlibOutputStream zout( main );
+			WriteMain( zout );
+			zout.Close();
 		}
+
+		wxFileOffset pos = out.TellO();
+		out.Write( main.GetOutputStreamBuffer()->GetBufferStart(), main.GetLength() );
+		out.SeekO( 3 );
+		dout.Write64( (wxUint64)pos );
+		ok = out.IsOk() && out.Close();
 	}
-	return equal;
+
+	if ( ok && replace && !wxRenameFile( target, file, true ) )
+	{
+		// some platforms won't replace a file that is still mapped
+		LargeValueSource::Detach( file );
+		ok = wxRenameFile( target, file, true );
+	}
+
+	if ( !ok && replace )
+		wxRemoveFile( target );
+
+	return ok;
 }
 
+bool LargeValueArchive::ReadArchive( const wxString &file )
+{
+	wxFFileInputStream in( file );
+	if ( !in.IsOk() ) return false;
+	
+	wxUint8 code1, code2, comp;
+	in.Read( &code1, 1 );
+	in.Read( &code2, 1 );
 
-void VarValue::Copy( const VarValue &rhs )
+	if ( code1 != 0x41 || code2 != 0xb9 )
+	{
+		// old format, uncompressed
+		in.Ungetch( code2 );
+		in.Ungetch( code1 );
+		
+		return ReadMain( in );
+	}
+	else
+	{
+		// determine compression format
+		in.Read(&comp, 1);
+		if ( comp == 2 )
+		{
+			// large values stay in the mapped file and are loaded on first use
+			std::shared_ptr<LargeValueSource> src( new LargeValueSource );
+			if ( !src->Open( file ) || src->Size() < 11 )
+				return false;
+
+			wxMemoryInputStream header( src->Data() + 3, 8 );
+			wxUint64 pos = wxDataInputStream( header ).Read64();
+			if ( pos < 11 || pos >= src->Size() )
+				return false;
+
+			wxMemoryInputStream main( src->Data() + pos, src->Size() - (size_t)pos );
+			wxZlibInputStream zin( main );
+			LargeValueReader large( src );
+			return ReadMain( zin );
+		}
+		else if ( comp != 1 ) // unknown compression type
+			return false;
+
+		wxZlibInputStream zin( in );
+		return ReadMain( zin );
+	}
+}
+
+void VarValue::SharedMatrix::Defer( std::shared_ptr<LargeValueSource> src, wxUint64 off, wxUint64 len, int cod, size_t r, size_t c )
 {
-	if ( this != &rhs )
+	source = src;
+	offset = off;
+	length = len;
+	codec = cod;
+	nr = r;
+	nc = c;
+	mat.clear();
+	pending = true;
+}
+
+void VarValue::SharedMatrix::Load()
+{
+	// copies of a value share the payload, possibly on other threads,
+	// so the first one to use it loads it for all of them
+	if ( !pending ) return;
+
+	// the source is released after the lock, since dropping the last
+	// reference to it takes the lock again
+	std::shared_ptr<LargeValueSource> released;
 	{
-		m_type = rhs.m_type;
-		m_str = rhs.m_str;
-		m_val = rhs.m_val;
-		m_tab = rhs.m_tab;
-		// wxMemeoryBuffer is not a copy on write so causing issues bewtween cases, e.g. shade_scen_3d
-		//		m_bin = rhs.m_bin;
-		m_bin.Clear();
-		m_bin.AppendData(rhs.m_bin.GetData(),rhs.m_bin.GetDataLen());
-        auto datarr = &(rhs.m_datarr);
-        for (auto& i : *datarr){
-            m_datarr.emplace_back(i);
-        }
-        auto datmat = &(rhs.m_datmat);
-        for (auto& i : *datmat){
-            std::vector<VarValue> row;
-            for (auto& j : i)
-                row.emplace_back(j);
-            m_datmat.emplace_back(row);
-        }
+		wxMutexLocker _lock( gs_largeValueLock );
+		if ( !pending ) return;
 
-        // UI hints?
-    }
+		mat.resize( nr, nc );
+		if ( !source->Load( offset, length, codec, mat.data(), nr*nc ) )
+		{
+			wxLogStatus( "could not load %d x %d value from %s", (int)nr, (int)nc, (const char*)source->GetFile().c_str() );
+			mat.resize_fill( nr, nc, 0.0 );
+		}
+		else
+			best_codec = codec;
+		released.swap( source );
+		pending = false;
+	}
 }
 
+bool VarValue::SharedMatrix::CopyPending( LargeValueWriter &large, wxUint64 *new_offset )
+{
+	// a payload that was never loaded goes across still compressed
+	wxMutexLocker _lock( gs_largeValueLock );
+	if ( !pending || offset + length > source->Size() ) return false;
+	return large.Copy( source->Data() + offset, length, new_offset );
+}
+
+void VarValue::SharedMatrix::Discard()
+{
+	// only called on an unshared payload whose contents are being replaced
+	if ( pending )
+	{
+		source.reset();
+		mat.resize( nr, nc );
+		pending = false;
+	}
+}
 
 void VarValue::Write( wxOutputStream &_O )
 {
@@ -993,7 +2014,13 @@ void VarValue::Write( wxOutputStream &_O )
 
 	out.Write8( 0xf2 );
 //	out.Write8(1);
-	out.Write8(2); // float to double
+//	out.Write8(2); // float to double
+//	out.Write8(3); // numeric payloads as one little-endian block
+//	out.Write8(4); // numeric payloads tagged with their encoding
+	// older builds don't check the version, so the encoded layout is only
+	// written to files they never read
+	bool encoded = NumericEncodingScope::Active();
+	out.Write8( encoded ? 4 : 3 );
 
 	out.Write8( m_type );
 
@@ -1004,22 +2031,51 @@ void VarValue::Write( wxOutputStream &_O )
 	case VV_NUMBER:
 	case VV_ARRAY:
 	case VV_MATRIX:
-		out.Write32( m_val.nrows() );
-		out.Write32( m_val.ncols() );
-		for ( size_t r=0;r<m_val.nrows();r++ )
-			for( size_t c=0;c<m_val.ncols();c++ )
-				out.WriteDouble(m_val(r, c));
-//		out.WriteFloat(m_val(r, c));
+		{
+			size_t n = NumRows() * NumCols();
+			out.Write32( NumRows() );
+			out.Write32( NumCols() );
+
+			LargeValueWriter *large = LargeValueWriter::Current();
+			if ( large && m_type != VV_NUMBER && n >= LARGE_VALUE_MIN_LEN )
+			{
+				SharedMatrix *sm = m_data.matrix;
+				wxUint64 offset = 0, length = 0;
+				int codec = NUMERIC_RAW;
+				if ( sm->CopyPending( *large, &offset ) )
+				{
+					codec = sm->codec;
+					length = sm->length;
+				}
+				else
+				{
+					codec = sm->Codec();
+					large->Put( codec, NumData(), n, &offset, &length );
+				}
+				out.Write8( NUMERIC_LARGE_VALUE );
+				out.Write8( codec );
+				out.Write64( offset );
+				out.Write64( length );
+			}
+			else if ( encoded )
+			{
+				int codec = m_store == VS_MATRIX ? m_data.matrix->Codec() : NUMERIC_RAW;
+				out.Write8( codec );
+				write_numeric_block( _O, codec, NumData(), n );
+			}
+			else
+				write_double_block( _O, NumData(), n );
+		}
 		break;
 	case VV_TABLE:
-		m_tab.Write( _O );
+		Tab().Write( _O );
 		break;
 	case VV_STRING:
-		out.WriteString( m_str );
+		out.WriteString( StoredString() );
 		break;
 	case VV_BINARY:
-		out.Write32( m_bin.GetDataLen() );
-		_O.Write( m_bin.GetData(), m_bin.GetDataLen() );
+		out.Write32( Bin().GetDataLen() );
+		_O.Write( Bin().GetData(), Bin().GetDataLen() );
 		break;
     case VV_DATMAT:
     case VV_DATARR:
@@ -1036,45 +2092,99 @@ bool VarValue::Read(wxInputStream &_I)
 	wxUint8 code = in.Read8();
 	wxUint8 ver = in.Read8(); // ver
 
-	m_type = in.Read8();
+	// the type is only set once the payload is in place, a value
+	// that fails to read is left invalid
+	int type = in.Read8();
+	bool ok = true;
 
 	size_t nr, nc, len;
-	switch (m_type)
+	switch (type)
 	{
 	case VV_INVALID:
+		Release();
 		break;
 	case VV_NUMBER:
 	case VV_ARRAY:
 	case VV_MATRIX:
 		nr = in.Read32();
 		nc = in.Read32();
-		if (nr*nc < 1) return false; // big error
-		m_val.resize_fill(nr, nc, 0.0f);
-		for (size_t r = 0; r<nr; r++)
-			for (size_t c = 0; c < nc; c++)
+		if (nr*nc < 1) { ok = false; break; } // big error
+		if (ver >= 3)
+		{
+			int codec = ver >= 4 ? in.Read8() : NUMERIC_RAW;
+			if (codec == NUMERIC_LARGE_VALUE)
+			{
+				// the payload stays in the archive until it is used
+				std::shared_ptr<LargeValueSource> src = LargeValueReader::Current();
+				int large_codec = in.Read8();
+				wxUint64 offset = in.Read64();
+				wxUint64 length = in.Read64();
+				if (!src || offset + length > src->Size()) { ok = false; break; }
+				SharedMatrix *sm = new SharedMatrix;
+				sm->Defer(src, offset, length, large_codec, nr, nc);
+				Release();
+				m_data.matrix = sm;
+				m_store = VS_MATRIX;
+			}
+			else
 			{
-				if (ver == 1)
-					m_val(r, c) = in.ReadFloat();
+				double *p;
+				if (type == VV_NUMBER && nr*nc == 1)
+				{
+					StoreNumber(0.0);
+					p = NumData();
+				}
 				else
-					m_val(r, c) = in.ReadDouble();
+				{
+					NewMat().resize(nr, nc);
+					p = NumData();
+				}
+				if (!read_numeric_block(_I, codec, p, nr*nc)) ok = false;
 			}
+		}
+		else if (type == VV_NUMBER && nr*nc == 1)
+			StoreNumber( ver == 1 ? in.ReadFloat() : in.ReadDouble() );
+		else
+		{
+			matrix_t<double> &mat = NewMat();
+			mat.resize_fill(nr, nc, 0.0f);
+			for (size_t r = 0; r<nr; r++)
+				for (size_t c = 0; c < nc; c++)
+				{
+					if (ver == 1)
+						mat(r, c) = in.ReadFloat();
+					else
+						mat(r, c) = in.ReadDouble();
+				}
+		}
 		break;
 	case VV_TABLE:
-		m_tab.Read(_I);
+		Tab().Read(_I);
 		break;
 	case VV_STRING:
-		m_str = in.ReadString();
+		StoreString( in.ReadString() );
 		break;
 	case VV_BINARY:
-		len = in.Read32();
-		_I.Read(m_bin.GetWriteBuf(len), len);
-		m_bin.UngetWriteBuf(len);
+		{
+			wxMemoryBuffer &bin = Bin();
+			len = in.Read32();
+			_I.Read(bin.GetWriteBuf(len), len);
+			bin.UngetWriteBuf(len);
+		}
 		break;
     case VV_DATMAT:
     case VV_DATARR:
         throw(std::runtime_error("Function not implemented for VV_DATARR AND VV_DATMAT"));
 	}
 
+	if ( !ok )
+	{
+		Release();
+		m_type = VV_INVALID;
+		return false;
+	}
+
+	m_type = (unsigned char)type;
 	return in.Read8() == code;
 }
 
@@ -1096,40 +2206,30 @@ void VarValue::Write_text(wxOutputStream &_O)
 	case VV_NUMBER:
 	case VV_ARRAY:
 	case VV_MATRIX:
-		out.Write32(m_val.nrows());
-		out.PutChar('\n');
-		out.Write32(m_val.ncols());
-		out.PutChar('\n');
-		for (size_t r = 0; r < m_val.nrows(); r++)
 		{
-			for (size_t c = 0; c < m_val.ncols(); c++)
+			size_t nr = NumRows(), nc = NumCols();
+			double *p = NumData();
+			out.Write32(nr);
+			out.PutChar('\n');
+			out.Write32(nc);
+			out.PutChar('\n');
+			for (size_t r = 0; r < nr; r++)
 			{
-				out.WriteDouble(m_val(r, c));
-				/*
-								wxString sd;
-				sd.Printf("%g", m_val(r, c));
-				out.WriteString(sd);
-void wxTextOutputStream::WriteDouble(double d)
-{
-	wxString str;
-
-	str.Printf(wxT("%f"), d);
-	WriteString(str);
-}
-
-*/
-	//			out.PutChar('\n');
-				if (m_val.nrows()*m_val.ncols() > 1) out.PutChar(' ');
+				for (size_t c = 0; c < nc; c++)
+				{
+					out.WriteDouble(p[r*nc + c]);
+					if (nr*nc > 1) out.PutChar(' ');
+				}
+				if (nr*nc > 1) out.PutChar('\n');
 			}
-			if (m_val.nrows()*m_val.ncols() > 1) out.PutChar('\n');
+			out.PutChar('\n');
 		}
-		out.PutChar('\n');
 		break;
 	case VV_TABLE:
-		m_tab.Write_text(_O);
+		Tab().Write_text(_O);
 		break;
 	case VV_STRING:
-		x = m_str;
+		x = StoredString();
 		if (wxFileName::Exists(x))
 		{ // write filename only
 			wxString fn, ext;
@@ -1153,13 +2253,14 @@ void wxTextOutputStream::WriteDouble(double d)
     case VV_DATARR:
         throw(std::runtime_error("Function not implemented for VV_DATARR AND VV_DATMAT"));
 	case VV_BINARY:
-		out.Write32(m_bin.GetDataLen());
-		out.PutChar('\n');
-		wxByte *p = (wxByte*)m_bin.GetData();
-		for (size_t i = 0; i < m_bin.GetDataLen(); i++)
-			out.Write(p[i]);
-//		_O.Write(m_bin.GetData(), m_bin.GetDataLen());
-//		out.PutChar('`');
+		{
+			wxMemoryBuffer &bin = Bin();
+			out.Write32(bin.GetDataLen());
+			out.PutChar('\n');
+			wxByte *p = (wxByte*)bin.GetData();
+			for (size_t i = 0; i < bin.GetDataLen(); i++)
+				out.Write(p[i]);
+		}
 		break;
 	}
 
@@ -1172,78 +2273,87 @@ bool VarValue::Read_text(wxInputStream &_I)
 
 	in.Read8(); // ver
 
-	m_type = in.Read8();
+	// as in Read(), the type is set once the payload is in place
+	int type = in.Read8();
 
 	bool ok = true;
 
 	size_t nr, nc, len;
-	switch (m_type)
+	switch (type)
 	{
 	    default:
         case VV_INVALID:
+            Release();
             break;
         case VV_NUMBER:
         case VV_ARRAY:
         case VV_MATRIX:
             nr = in.Read32();
             nc = in.Read32();
-            if (nr*nc < 1) return false; // big error
-            m_val.resize_fill(nr, nc, 0.0);
+            if (nr*nc < 1) { ok = false; break; } // big error
             if (nc*nr > 1)
             {
-                for (size_t r = 0; r < nr; r++)
+                matrix_t<double> &mat = NewMat();
+                mat.resize_fill(nr, nc, 0.0);
+                for (size_t r = 0; r < nr && ok; r++)
                 {
                     wxString x = in.ReadLine();
                     wxArrayString ar = wxStringTokenize(x, ' ');
-                    if (nc != ar.Count()) return false;
-                    for (size_t c = 0; c < nc; c++)
+                    if (nc != ar.Count()) { ok = false; break; }
+                    for (size_t c = 0; c < nc && ok; c++)
                     {
                         double y;
                         if (ar[c].ToDouble(&y))
-                            m_val(r, c) = y;
+                            mat(r, c) = y;
                         else
-                            return false;
+                            ok = false;
                     }
                 }
             }
+            else if (type == VV_NUMBER)
+                StoreNumber(in.ReadDouble());
             else
-                m_val(0, 0) = in.ReadDouble();
-            /*
-            for (size_t r = 0; r < nr; r++)
-                for (size_t c = 0; c < nc; c++)
-                {
-            //		m_val(r, c) = in.ReadDouble();
-                }
-                */
+            {
+                matrix_t<double> &mat = NewMat();
+                mat.resize_fill(1, 1, 0.0);
+                mat(0, 0) = in.ReadDouble();
+            }
             break;
         case VV_TABLE:
-            ok = ok && m_tab.Read_text(_I);
+            ok = ok && Tab().Read_text(_I);
             break;
         case VV_STRING:
-            n = in.Read32();
-            m_str.Clear();
-            if (n > 0)
             {
+                wxString str;
+                n = in.Read32();
                 for (size_t i = 0; i < n; i++)
-                    m_str.Append(in.GetChar());
+                    str.Append(in.GetChar());
+                StoreString(str);
             }
             break;
         case VV_BINARY:
-            len = in.Read32();
-            m_bin.SetBufSize(len);
-            m_bin.Clear();
-    //		char *p = (char*)m_bin.GetWriteBuf(len);
-            for (size_t i = 0; i <len; i++)
-                m_bin.AppendByte(in.GetChar());
-
-    //		_I.Read(m_bin.GetWriteBuf(len), len);
-    //		m_bin.UngetWriteBuf(len);
+            {
+                wxMemoryBuffer &bin = Bin();
+                len = in.Read32();
+                bin.SetBufSize(len);
+                bin.Clear();
+                for (size_t i = 0; i <len; i++)
+                    bin.AppendByte(in.GetChar());
+            }
             break;
         case VV_DATMAT:
         case VV_DATARR:
                 throw(std::runtime_error("Function not implemented for VV_DATARR AND VV_DATMAT"));
 	}
 
+	if ( !ok )
+	{
+		Release();
+		m_type = VV_INVALID;
+		return false;
+	}
+
+	m_type = (unsigned char)type;
 	return ok;
 //	return in.Read8() == code;
 }
@@ -1253,41 +2363,48 @@ bool VarValue::AsSSCVar(ssc_var_t p_var) {
     ssc_var_t entry = ssc_var_create();
     switch (m_type){
         case VV_STRING:
-            ssc_var_set_string(p_var, m_str.c_str());
+            if (m_store == VS_SHORTSTR)
+                ssc_var_set_string(p_var, m_data.shortstr);
+            else
+                ssc_var_set_string(p_var, StoredString().c_str());
             break;
         case VV_NUMBER:
-            ssc_var_set_number(p_var, m_val);
+            ssc_var_set_number(p_var, StoredNumber());
             break;
         case VV_ARRAY:
-            ssc_var_set_array(p_var, static_cast<ssc_number_t*>(&m_val[0]), (int)m_val.length());
+            ssc_var_set_array(p_var, static_cast<ssc_number_t*>(NumData()), (int)(NumRows() * NumCols()));
             break;
         case VV_MATRIX:
-            ssc_var_set_matrix(p_var, static_cast<ssc_number_t*>(&m_val[0]), (int)m_val.nrows(), (int)m_val.ncols());
+            ssc_var_set_matrix(p_var, static_cast<ssc_number_t*>(NumData()), (int)NumRows(), (int)NumCols());
             break;
         case VV_TABLE:
         {
             ssc_data_t table = ssc_data_create();
-            m_tab.AsSSCData(table);
+            Tab().AsSSCData(table);
             ssc_var_set_table(p_var, table);
             ssc_data_free(table);
             break;
         }
         case VV_DATARR:
         {
-            for (size_t i = 0; i < m_datarr.size(); i++){
-                m_datarr[i].AsSSCVar(entry);
+            std::vector<VarValue> &datarr = DatArr();
+            for (size_t i = 0; i < datarr.size(); i++){
+                datarr[i].AsSSCVar(entry);
                 ssc_var_set_data_array(p_var, entry, i);
             }
             break;
         }
         case VV_DATMAT:
-            for (size_t i = 0; i < m_datmat.size(); i++){
-                for (size_t j = 0; j < m_datmat[0].size(); j++){
-                    m_datmat[i][j].AsSSCVar(entry);
+        {
+            std::vector<std::vector<VarValue>> &datmat = DatMat();
+            for (size_t i = 0; i < datmat.size(); i++){
+                for (size_t j = 0; j < datmat[0].size(); j++){
+                    datmat[i][j].AsSSCVar(entry);
                     ssc_var_set_data_matrix(p_var, entry, i, j);
                 }
             }
             break;
+        }
         case VV_INVALID:
             break;
         case VV_BINARY:
@@ -1299,6 +2416,50 @@ bool VarValue::AsSSCVar(ssc_var_t p_var) {
     return true;
 }
 
+bool VarValue::AssignSSCData(ssc_data_t p_dat, const char *name) {
+    switch (m_type){
+        case VV_STRING:
+            if (m_store == VS_SHORTSTR)
+                ssc_data_set_string(p_dat, name, m_data.shortstr);
+            else
+                ssc_data_set_string(p_dat, name, StoredString().c_str());
+            return true;
+        case VV_NUMBER:
+            ssc_data_set_number(p_dat, name, StoredNumber());
+            return true;
+        case VV_ARRAY:
+            // a shared buffer is read as is, it is not detached for ssc
+            ssc_data_set_array(p_dat, name, static_cast<ssc_number_t*>(NumData()), (int)(NumRows() * NumCols()));
+            return true;
+        case VV_MATRIX:
+            ssc_data_set_matrix(p_dat, name, static_cast<ssc_number_t*>(NumData()), (int)NumRows(), (int)NumCols());
+            return true;
+        case VV_TABLE:
+        {
+            ssc_data_t table = ssc_data_create();
+            bool ok = Tab().AsSSCData(table);
+            if (ok)
+                ssc_data_set_table(p_dat, name, table);
+            ssc_data_free(table);
+            return ok;
+        }
+        default:
+        {
+            ssc_var_t var = ssc_var_create();
+            bool ok = AsSSCVar(var);
+            if (ok)
+                ssc_data_set_var(p_dat, name, var);
+            ssc_var_free(var);
+            return ok;
+        }
+    }
+}
+
+bool VarValue::SharesData( const VarValue &rhs ) const
+{
+	return m_store == VS_MATRIX && rhs.m_store == VS_MATRIX
+		&& m_type == rhs.m_type && m_data.matrix == rhs.m_data.matrix;
+}
 
 int VarValue::Type() const { return m_type; }
 wxString VarValue::TypeAsString() const {
@@ -1316,42 +2477,67 @@ wxString VarValue::TypeAsString() const {
 	return wxString();
 }
 
-void VarValue::ChangeType(int type) { m_type = (unsigned char)type; }
-void VarValue::SetType( int ty ) { m_type = (unsigned char)ty; }
-void VarValue::Set( int val ) { m_type = VV_NUMBER; m_val = (float)val; }
+void VarValue::ChangeType(int type) { SetType( type ); }
+void VarValue::SetType( int ty )
+{
+	m_type = (unsigned char)ty;
+
+	// keep the payload if it can hold the new type, numbers, arrays
+	// and matrices all share the numeric storage
+	switch( m_type )
+	{
+	case VV_NUMBER:
+		if ( m_store != VS_NUMBER && m_store != VS_MATRIX ) StoreNumber( 0.0 );
+		break;
+	case VV_ARRAY:
+	case VV_MATRIX:
+		if ( m_store != VS_MATRIX ) Mat();
+		break;
+	case VV_STRING:
+		if ( m_store != VS_SHORTSTR && m_store != VS_STRING ) StoreString( wxEmptyString );
+		break;
+	case VV_TABLE: Tab(); break;
+	case VV_BINARY: Bin(); break;
+	case VV_DATARR: DatArr(); break;
+	case VV_DATMAT: DatMat(); break;
+	default: Release(); break;
+	}
+}
+void VarValue::Set( int val ) { m_type = VV_NUMBER; StoreNumber( (float)val ); }
 //void VarValue::Set( float val ) { m_type = VV_NUMBER; m_val = val; }
-void VarValue::Set( double val ) { m_type = VV_NUMBER; m_val = val; }
+void VarValue::Set( double val ) { m_type = VV_NUMBER; StoreNumber( val ); }
 
 void VarValue::Set( const std::vector<int> &ivec )
 {
 	m_type = VV_ARRAY;
+	matrix_t<double> &mat = NewMat();
 	if ( ivec.size() > 0 )
 	{
-		m_val.resize_fill( ivec.size(), 0 );
+		mat.resize_fill( ivec.size(), 0 );
 		for( size_t i=0;i<ivec.size();i++ )
-			m_val.at(i) = (double)ivec[i];
+			mat.at(i) = (double)ivec[i];
 	}
 	else
-		m_val.clear();
+		mat.clear();
 }
 
 void VarValue::Set( const std::vector<double> &fvec )
 {
 	m_type = VV_ARRAY;
-	if( fvec.size() > 0 ) m_val.assign( &fvec[0], fvec.size() );
-	else m_val.clear();
+	if( fvec.size() > 0 ) NewMat().assign( &fvec[0], fvec.size() );
+	else NewMat().clear();
 }
 
-void VarValue::Set( double *val, size_t n ) { m_type = VV_ARRAY; m_val.assign( val, n ); }
-void VarValue::Set(double *mat, size_t r, size_t c ) { m_type = VV_MATRIX; m_val.assign( mat, r, c ); }
-void VarValue::Set( const matrix_t<double> &mat ) { m_type = VV_MATRIX; m_val = mat; }
-void VarValue::Set( const wxString &str ) { m_type = VV_STRING; m_str = str; }
-void VarValue::Set( const VarTable &tab ) { m_type = VV_TABLE; m_tab.Copy( tab ); }
-void VarValue::Set( const wxMemoryBuffer &mb ) { m_type = VV_BINARY; m_bin = mb; }
+void VarValue::Set( double *val, size_t n ) { m_type = VV_ARRAY; NewMat().assign( val, n ); }
+void VarValue::Set(double *mat, size_t r, size_t c ) { m_type = VV_MATRIX; NewMat().assign( mat, r, c ); }
+void VarValue::Set( const matrix_t<double> &mat ) { m_type = VV_MATRIX; NewMat() = mat; }
+void VarValue::Set( const wxString &str ) { m_type = VV_STRING; StoreString( str ); }
+void VarValue::Set( const VarTable &tab ) { m_type = VV_TABLE; Tab().Copy( tab ); }
+void VarValue::Set( const wxMemoryBuffer &mb ) { m_type = VV_BINARY; Bin() = mb; }
 
 int VarValue::Integer()
 {
-	if ( m_type == VV_NUMBER ) return (int)(float)m_val;
+	if ( m_type == VV_NUMBER ) return (int)(float)StoredNumber();
 	else return 0;
 }
 
@@ -1363,33 +2549,49 @@ bool VarValue::Boolean()
 
 double VarValue::Value()
 {
-	if ( m_type == VV_NUMBER || Length() == 1) return (double)m_val;
+	if ( m_type == VV_NUMBER || Length() == 1) return StoredNumber();
 	else return std::numeric_limits<double>::quiet_NaN();
 }
 
 size_t VarValue::Length()
 {
-	if ( m_type == VV_ARRAY ) return m_val.length();
+	if ( m_type == VV_ARRAY ) return NumRows() * NumCols();
 	else return 0;
 }
 size_t VarValue::Rows()
 {
-	if (m_type == VV_ARRAY || m_type == VV_MATRIX) return m_val.nrows();
+	if (m_type == VV_ARRAY || m_type == VV_MATRIX) return NumRows();
 	else if (m_type == VV_NUMBER) return 1;
 	else return 0;
 }
 size_t VarValue::Columns()
 {
-	if (m_type == VV_ARRAY || m_type == VV_MATRIX) return m_val.ncols();
+	if (m_type == VV_ARRAY || m_type == VV_MATRIX) return NumCols();
 	else if (m_type == VV_NUMBER) return 1;
 	else return 0;
 }
-double *VarValue::Array( size_t *n )
+const double *VarValue::Array( size_t *n ) const
+{
+	if ( m_type == VV_ARRAY && m_store == VS_MATRIX )
+	{
+		m_data.matrix->Load();
+		if ( n != 0 ) *n = m_data.matrix->mat.length();
+		return m_data.matrix->mat.data();
+	}
+	else
+	{
+		if ( n != 0 ) *n = 0;
+		return 0;
+	}
+}
+
+double *VarValue::WritableArray( size_t *n )
 {
 	if ( m_type == VV_ARRAY )
 	{
-		if ( n != 0 ) *n = m_val.length();
-		return m_val.data();
+		matrix_t<double> &mat = Mat();
+		if ( n != 0 ) *n = mat.length();
+		return mat.data();
 	}
 	else
 	{
@@ -1402,10 +2604,8 @@ std::vector<double> VarValue::Array()
 {
 	if ( m_type == VV_ARRAY )
 	{
-		std::vector<double> vec( m_val.length(), 0.0 );
-		for( size_t i=0;i<m_val.length();i++)
-			vec[i] = m_val[i];
-		return vec;
+		double *p = NumData();
+		return std::vector<double>( p, p + Length() );
 	}
 	else
 		return std::vector<double>();
@@ -1415,48 +2615,90 @@ std::vector<int> VarValue::IntegerArray()
 {
 	if ( m_type == VV_ARRAY )
 	{
-		std::vector<int> vec( m_val.length(), 0 );
-		for( size_t i=0;i<m_val.length();i++)
-			vec[i] = (int)m_val[i];
+		size_t n = Length();
+		double *p = NumData();
+		std::vector<int> vec( n, 0 );
+		for( size_t i=0;i<n;i++)
+			vec[i] = (int)p[i];
 		return vec;
 	}
 	else
 		return std::vector<int>();
 }
 
-matrix_t<double> &VarValue::Matrix()
+// handed out by the accessors of a type that a value doesn't hold, so a
+// mistaken call gets an empty object instead of replacing the value
+template< typename T > static T &scratch_payload()
+{
+	static thread_local T s_scratch;
+	s_scratch = T();
+	return s_scratch;
+}
+
+const matrix_t<double> &VarValue::Matrix() const
 {
-	return m_val;
+	if ( m_store == VS_MATRIX )
+	{
+		m_data.matrix->Load();
+		return m_data.matrix->mat;
+	}
+
+	// an inline number reads as a 1x1 matrix
+	matrix_t<double> &mat = scratch_payload< matrix_t<double> >();
+	if ( m_store == VS_NUMBER ) mat = m_data.number;
+	return mat;
+}
+
+const double *VarValue::Matrix( size_t *nr, size_t *nc ) const
+{
+	if ( m_store == VS_NUMBER )
+	{
+		*nr = *nc = 1;
+		return &m_data.number;
+	}
+
+	const matrix_t<double> &mat = Matrix();
+	*nr = mat.nrows();
+	*nc = mat.ncols();
+	return const_cast< matrix_t<double>& >( mat ).data();
 }
 
-double *VarValue::Matrix( size_t *nr, size_t *nc )
+matrix_t<double> &VarValue::WritableMatrix()
 {
-	*nr = m_val.nrows();
-	*nc = m_val.ncols();
-	return m_val.data();
+	if ( m_store != VS_NONE && m_store != VS_NUMBER && m_store != VS_MATRIX )
+		return scratch_payload< matrix_t<double> >();
+	return Mat();
 }
 
 wxString VarValue::String()
 {
-	return m_str;
+	return StoredString();
 }
 
 VarTable &VarValue::Table()
 {
-	return m_tab;
+	if ( m_store != VS_NONE && m_store != VS_TABLE )
+		return scratch_payload<VarTable>();
+	return Tab();
 }
 
 wxMemoryBuffer &VarValue::Binary()
 {
-	return m_bin;
+	if ( m_store != VS_NONE && m_store != VS_BINARY )
+		return scratch_payload<wxMemoryBuffer>();
+	return Bin();
 }
 
 std::vector<VarValue>& VarValue::DataArray(){
-    return m_datarr;
+	if ( m_store != VS_NONE && m_store != VS_DATARR )
+		return scratch_payload< std::vector<VarValue> >();
+    return DatArr();
 }
 
 std::vector<std::vector<VarValue>>& VarValue::DataMatrix(){
-    return m_datmat;
+	if ( m_store != VS_NONE && m_store != VS_DATMAT )
+		return scratch_payload< std::vector<std::vector<VarValue>> >();
+    return DatMat();
 }
 
 bool VarValue::Read( const lk::vardata_t &val, bool change_type )
@@ -1513,7 +2755,8 @@ bool VarValue::Read( const lk::vardata_t &val, bool change_type )
 				if ( Type() == VV_MATRIX || change_type )
 				{
 					m_type = VV_MATRIX;
-					m_val.resize_fill( dim1, dim2, 0.0 );
+					matrix_t<double> &mat = NewMat();
+					mat.resize_fill( dim1, dim2, 0.0 );
 
 					for ( size_t i=0;i<dim1;i++)
 					{
@@ -1524,7 +2767,7 @@ bool VarValue::Read( const lk::vardata_t &val, bool change_type )
 								&& j < val.index(i)->length() )
 								x = (double)val.index(i)->index(j)->as_number();
 
-							m_val.at(i,j) = x;
+							mat.at(i,j) = x;
 						}
 					}
 
@@ -1569,8 +2812,8 @@ bool VarValue::Write( lk::vardata_t &val )
 		break;
 	case VV_ARRAY:
 		{
-			size_t n = 0;
-			double *p = Array( &n );
+			size_t n = Length();
+			double *p = NumData();
 			val.empty_vector();
 			if ( n > 0 )
 			{
@@ -1582,16 +2825,17 @@ bool VarValue::Write( lk::vardata_t &val )
 		break;
 	case VV_MATRIX:
 		{
-			matrix_t<double> &mat = Matrix();
+			size_t nr = NumRows(), nc = NumCols();
+			double *p = NumData();
 			val.empty_vector();
-			val.vec()->reserve( mat.nrows() );
-			for (size_t i=0;i<mat.nrows();i++)
+			val.vec()->reserve( nr );
+			for (size_t i=0;i<nr;i++)
 			{
 				val.vec()->push_back( lk::vardata_t() );
 				val.vec()->at(i).empty_vector();
-				val.vec()->at(i).vec()->reserve( mat.ncols() );
-				for (size_t j=0;j<mat.ncols();j++)
-					val.vec()->at(i).vec_append( mat.at(i,j) );
+				val.vec()->at(i).vec()->reserve( nc );
+				for (size_t j=0;j<nc;j++)
+					val.vec()->at(i).vec_append( p[i*nc + j] );
 			}
 		}
 		break;
@@ -1609,7 +2853,7 @@ bool VarValue::Write( lk::vardata_t &val )
 		}
 		break;
 	case VV_BINARY:
-			val.assign( wxString::Format("binary<%d>", (int)m_bin.GetDataLen() ) );
+			val.assign( wxString::Format("binary<%d>", (int)Bin().GetDataLen() ) );
 		break;
     case VV_DATMAT:
     case VV_DATARR:
@@ -1670,23 +2914,22 @@ bool VarValue::Parse( int type, const wxString &str, VarValue &value )
 	{
 	case VV_STRING:
 		{
-			value.m_type = VV_STRING;
-			value.m_str = str;
+			value.Set( str );
 			return true;
 		}
 	case VV_NUMBER:
 		{
-			value.m_type = VV_NUMBER;
-			value.m_val = wxAtof( str );
+			value.Set( (double)wxAtof( str ) );
 			return true;
 		}
 	case VV_ARRAY:
 		{
 			wxArrayString tokens = wxStringTokenize(str," ,;|", wxTOKEN_STRTOK );
 			value.m_type = VV_ARRAY;
-			value.m_val.resize_fill( tokens.size(), 0.0 );
+			matrix_t<double> &mat = value.NewMat();
+			mat.resize_fill( tokens.size(), 0.0 );
 			for (size_t i=0; i<tokens.size(); i++)
-					value.m_val[i] = wxAtof( tokens[i] );
+					mat[i] = wxAtof( tokens[i] );
 
 			return true;
 		}
@@ -1701,13 +2944,14 @@ bool VarValue::Parse( int type, const wxString &str, VarValue &value )
 			size_t ncols = cols.size();
 
 			value.m_type = VV_MATRIX;
-			value.m_val.resize_fill( nrows, ncols, 0.0 );
+			matrix_t<double> &mat = value.NewMat();
+			mat.resize_fill( nrows, ncols, 0.0 );
 
 			for (size_t r=0; r < nrows; r++)
 			{
 				cols = wxStringTokenize(rows[r], " ,;|");
 				for (size_t c=0; c<cols.size() && c<ncols; c++)
-					value.m_val(r,c) = wxAtof( cols[c] );
+					mat(r,c) = wxAtof( cols[c] );
 			}
 			return true;
 		}
@@ -1728,18 +2972,19 @@ bool VarValue::Parse( int type, const wxString &str, VarValue &value )
 				if (!vt.Set(name_type[0], vv)) return false;
 			}
 			if (vt.size() != hash.size()) return false;
-			value.m_tab = vt;
+			value.Tab() = vt;
 		return true;
 		}
 	case VV_BINARY: {
         value.m_type = VV_BINARY;
-        value.m_bin.Clear();
+        wxMemoryBuffer &bin = value.Bin();
+        bin.Clear();
         if (str.Len() > 0) {
             int nbytes = str.Len() / 2;
             if (nbytes * 2 != (int) str.Len()) return false;
-            char *data = (char *) value.m_bin.GetWriteBuf(nbytes);
+            char *data = (char *) bin.GetWriteBuf(nbytes);
             hexstrtobin(str, data, nbytes);
-            value.m_bin.UngetWriteBuf(nbytes);
+            bin.UngetWriteBuf(nbytes);
         }
         return true;
     }
@@ -1756,20 +3001,21 @@ wxString VarValue::AsString( wxChar arrsep, wxChar tabsep )
 	switch( m_type )
 	{
 	case VV_INVALID: return "<invalid>";
-	case VV_STRING: return m_str;
+	case VV_STRING: return StoredString();
 	case VV_NUMBER:
 	{
-		if (std::isnan((float)m_val))
+		if (std::isnan((float)StoredNumber()))
 			return "NaN";
 		else
-			return wxString::Format("%g", (float)m_val);
+			return wxString::Format("%g", (float)StoredNumber());
 	}
 	case VV_ARRAY:
 	{
 		std::string buf = "";
-		for( size_t i=0;i<m_val.length();i++ )
+		double *p = NumData();
+		for( size_t i=0;i<Length();i++ )
 		{
-			buf += wxString::Format("%g", (float)m_val[i]  );
+			buf += wxString::Format("%g", (float)p[i]  );
 			buf += arrsep;
 		}
 		buf.pop_back();
@@ -1778,13 +3024,15 @@ wxString VarValue::AsString( wxChar arrsep, wxChar tabsep )
 	case VV_MATRIX:
 	{
 		wxString buf="";
-		for( size_t r=0;r<m_val.nrows();r++ )
+		size_t nr = NumRows(), nc = NumCols();
+		double *p = NumData();
+		for( size_t r=0;r<nr;r++ )
 		{
 			buf += '[';
-			for( size_t c=0;c<m_val.ncols();c++ )
+			for( size_t c=0;c<nc;c++ )
 			{
-				buf += wxString::Format("%g", (float)m_val.at(r,c)  );
-				if ( c < m_val.ncols()-1 ) buf += arrsep;
+				buf += wxString::Format("%g", (float)p[r*nc + c]  );
+				if ( c < nc-1 ) buf += arrsep;
 			}
 			buf += ']';
 		}
@@ -1794,19 +3042,20 @@ wxString VarValue::AsString( wxChar arrsep, wxChar tabsep )
 	{
 		wxString buf = "";
 		size_t i = 0;
-		for (VarTable::iterator it = m_tab.begin(); it != m_tab.end(); ++it)
+		VarTable &tab = Tab();
+		for (VarTable::iterator it = tab.begin(); it != tab.end(); ++it)
 		{
 			buf += (it->first) + ":" + wxString::Format("%d",it->second->Type()) + "=" + it->second->AsString();
-			if ( ++i < (m_tab.size())) buf += tabsep;
+			if ( ++i < (tab.size())) buf += tabsep;
 		}
 
 		return buf;
 	}
 	case VV_BINARY:
-		return bintohexstr( (char*)m_bin.GetData(), m_bin.GetDataLen() );
+		return bintohexstr( (char*)Bin().GetData(), Bin().GetDataLen() );
     case VV_DATARR:{
         std::string buf = "";
-        for (auto& i : m_datarr){
+        for (auto& i : DatArr()){
             buf += i.AsString(arrsep, tabsep);
             buf += arrsep;
         }
@@ -1815,7 +3064,7 @@ wxString VarValue::AsString( wxChar arrsep, wxChar tabsep )
     }
     case VV_DATMAT:{
         std::string buf="";
-        for( auto& i : m_datmat )
+        for( auto& i : DatMat() )
         {
             buf += '[';
             for( auto& j : i )
@@ -2273,25 +3522,20 @@ wxString VarInfoLookup::LookupByLabel(const wxString &label)
 }
 
 
-VarTableScriptInterpreter::VarTableScriptInterpreter( lk::node_t *tree, lk::env_t *env, VarTable *vt )
-	: lk::eval( tree, env ), m_vars( vt )
-{
-}
-
-VarTableScriptInterpreter::~VarTableScriptInterpreter( ) { /* nothing to do */ }
-
-bool VarTableScriptInterpreter::special_set( const lk_string &name, lk::vardata_t &val )
+bool VarTableSpecials::Set( const lk_string &name, lk::vardata_t &val )
 {
 	bool ok = false;
-	if ( VarValue *vv = m_vars->Get( name ) )
-		ok = vv->Read( val );
+	if ( VarValue *vv = m_vars->GetWritable( name ) )
+		ok = vv->Read( val.deref() );
 
 //	wxLogStatus("vtsi->special_set( " + name + " ) " + wxString( ok?"ok":"fail") );
 	return ok;
 }
 
-bool VarTableScriptInterpreter::special_get( const lk_string &name, lk::vardata_t &val )
+bool VarTableSpecials::Get( const lk_string &name, lk::vardata_t &val )
 {
+	// arrays are converted on every read: lk functions like append() change
+	// their arguments in place, so each read needs a vector of its own
 	bool ok = false;
 	if ( VarValue *vv = m_vars->Get( name ) )
 		ok = vv->Write( val );
@@ -2300,3 +3544,20 @@ bool VarTableScriptInterpreter::special_get( const lk_string &name, lk::vardata_
 	return ok;
 }
 
+VarTableScriptInterpreter::VarTableScriptInterpreter( lk::node_t *tree, lk::env_t *env, VarTable *vt )
+	: lk::eval( tree, env ), m_specials( vt )
+{
+}
+
+VarTableScriptInterpreter::~VarTableScriptInterpreter( ) { /* nothing to do */ }
+
+bool VarTableScriptInterpreter::special_set( const lk_string &name, lk::vardata_t &val )
+{
+	return m_specials.Set( name, val );
+}
+
+bool VarTableScriptInterpreter::special_get( const lk_string &name, lk::vardata_t &val )
+{
+	return m_specials.Get( name, val );
+}
+
@@ -24,6 +24,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define __variable_h
 
 #include <vector>
+#include <memory>
 #include <unordered_map>
 
 #include <wx/string.h>
@@ -104,6 +105,18 @@ public:
 	VarValue *Get( const wxString &name );
 	bool Rename( const wxString &old_name, const wxString &new_name );
 
+	// a table can be layered over a shared base table: Get() falls through
+	// to the base for names not in this table, but the base is never modified.
+	// use GetWritable() to change a value in place, which first copies it
+	// from the base if needed.  iteration and size() only cover this table,
+	// call Flatten() to pull in all base values and detach from the base.
+	// a pointer from Get() may point into the base, which other tables
+	// share, so never change a value through it on a layered table
+	void SetBase( std::shared_ptr<VarTable> base );
+	VarTable *GetBase() { return m_base.get(); }
+	VarValue *GetWritable( const wxString &name );
+	void Flatten();
+
 	void Write( wxOutputStream &, size_t maxdim = 0 ); // MaxDim specifies the maximum allowable array or matrix dimension when writing.
 	bool Write( const wxString &file, size_t maxdim= 0);
 	bool Read( wxInputStream & );
@@ -116,13 +129,21 @@ public:
 
     // returns a pointer to a ssc::var_table class that'll need to be freed using ssc_data_free
     bool AsSSCData(ssc_data_t p_dat);
+
+private:
+	std::shared_ptr<VarTable> m_base;
 };
 
+// a value holds only its active payload: numbers and short ascii strings
+// are stored inline, everything else is allocated on demand and owned by
+// the value.  numbers, arrays and matrices share the same numeric storage,
+// which is reference counted across copies and copied on write.
 class VarValue
 {
 public:
 	VarValue();
 	VarValue( const VarValue &vv );
+	VarValue( VarValue &&vv ) noexcept;
 
 	explicit VarValue( int i );
 	explicit VarValue( bool b );
@@ -137,11 +158,17 @@ public:
 	VarValue( double *arr, size_t n );
 	VarValue( double *mat, size_t r, size_t c );
 
-	virtual ~VarValue();
+	~VarValue();
 
 	VarValue &operator=( const VarValue &rhs );
+	VarValue &operator=( VarValue &&rhs ) noexcept;
 	bool ValueEqual( VarValue &rhs);
+	// exact equality: numbers compare bit for bit, and tables and data
+	// arrays are never considered identical unless they share storage
+	bool Identical( VarValue &rhs );
 	void Copy( const VarValue &rhs );
+	// true when both values hold the same shared array or matrix buffer
+	bool SharesData( const VarValue &rhs ) const;
 
 	void Write(wxOutputStream &);
 	bool Read(wxInputStream &);
@@ -152,6 +179,12 @@ public:
 	// returns a pointer to a ssc::var_data class that'll need to be freed using ssc_var_free
     bool AsSSCVar(ssc_var_t p_var);
 
+	// assigns this value to 'name' in p_dat. numbers, strings, arrays and matrices
+	// are handed to ssc straight from the value's own storage, which ssc only reads
+	// during the call: ssc keeps its own copy, so the value may change or go away
+	// afterwards, and nothing is staged through an intermediate ssc_var
+	bool AssignSSCData(ssc_data_t p_dat, const char *name);
+
 	int Type() const;
 	wxString TypeAsString() const;
 	void ChangeType(int type);
@@ -171,14 +204,19 @@ public:
 	int Integer();
 	bool Boolean();
 	double Value();
-	double *Array( size_t *n );
+	// arrays and matrices are read in place, without copying storage
+	// shared with other values, so never write through these
+	const double *Array( size_t *n ) const;
 	std::vector<double> Array();
 	size_t Length();
 	size_t Rows();
 	size_t Columns();
 	std::vector<int> IntegerArray();
-	matrix_t<double> &Matrix();
-	double *Matrix( size_t *nr, size_t *nc );
+	const matrix_t<double> &Matrix() const;
+	const double *Matrix( size_t *nr, size_t *nc ) const;
+	// writing first copies any storage shared with other values
+	double *WritableArray( size_t *n );
+	matrix_t<double> &WritableMatrix();
 	wxString String();
 	VarTable &Table();
 	wxMemoryBuffer &Binary();
@@ -194,14 +232,128 @@ public:
 
 	static VarValue Invalid;
 private:
+	enum { VS_NONE, VS_NUMBER, VS_SHORTSTR, VS_MATRIX, VS_STRING, VS_TABLE, VS_BINARY, VS_DATARR, VS_DATMAT };
+	enum { SHORTSTR_LEN = 23 };
+	struct SharedMatrix;
+
+	void Release();
+	void StoreNumber( double val );
+	void StoreString( const wxString &str );
+	double StoredNumber();
+	wxString StoredString();
+	size_t NumRows();
+	size_t NumCols();
+	double *NumData();
+	matrix_t<double> &Mat();
+	matrix_t<double> &NewMat();
+	VarTable &Tab();
+	wxMemoryBuffer &Bin();
+	std::vector<VarValue> &DatArr();
+	std::vector<std::vector<VarValue>> &DatMat();
+
 	unsigned char m_type;
-	matrix_t<double> m_val;
-	wxString m_str;
-	VarTable m_tab;
-	wxMemoryBuffer m_bin;
-	std::vector<VarValue> m_datarr;
-    std::vector<std::vector<VarValue>> m_datmat;
+	unsigned char m_store; // which member of m_data is active
+	union {
+		double number;
+		char shortstr[SHORTSTR_LEN+1];
+		SharedMatrix *matrix;
+		wxString *string;
+		VarTable *table;
+		wxMemoryBuffer *binary;
+		std::vector<VarValue> *datarr;
+		std::vector<std::vector<VarValue>> *datmat;
+	} m_data;
+};
+
+class MappedFile;
+
+// large arrays and matrices stored out of line in a project archive.
+// while a LargeValueWriter is in scope on a thread, VarValue::Write puts
+// long numeric payloads into its stream and leaves only a reference behind.
+// while a LargeValueReader is in scope, VarValue::Read keeps the references
+// and each payload is loaded from the mapped archive on first use
+class LargeValueSource
+{
+public:
+	LargeValueSource();
+	~LargeValueSource();
+
+	bool Open( const wxString &file );
+	wxString GetFile() const { return m_file; }
+	const char *Data() const;
+	size_t Size() const;
+
+	bool Load( wxUint64 offset, wxUint64 length, int codec, double *p, size_t n );
+
+	// true while values may still be loaded from the file
+	static bool InUse( const wxString &file );
+	// reads every source on the file into memory, so the file can be replaced
+	static void Detach( const wxString &file );
 
+private:
+	LargeValueSource( const LargeValueSource & ) = delete;
+	LargeValueSource &operator=( const LargeValueSource & ) = delete;
+
+	wxString m_file;
+	MappedFile *m_map;
+};
+
+class LargeValueWriter
+{
+public:
+	LargeValueWriter( wxOutputStream &os );
+	~LargeValueWriter();
+
+	bool Put( int codec, double *p, size_t n, wxUint64 *offset, wxUint64 *length );
+	bool Copy( const char *data, wxUint64 length, wxUint64 *offset );
+
+	static LargeValueWriter *Current();
+private:
+	wxOutputStream &m_os;
+	LargeValueWriter *m_prev;
+};
+
+// values written on this thread while one of these exists use stream
+// version 4, which encodes long numeric series so they compress better.
+// builds before version 4 misread it, so only files those builds never
+// open enable it.  values written into a format 2 project archive always
+// use it; everything else keeps the version 3 layout
+class NumericEncodingScope
+{
+public:
+	NumericEncodingScope();
+	~NumericEncodingScope();
+
+	static bool Active();
+};
+
+class LargeValueReader
+{
+public:
+	LargeValueReader( std::shared_ptr<LargeValueSource> src );
+	~LargeValueReader();
+
+	static std::shared_ptr<LargeValueSource> Current();
+private:
+	std::shared_ptr<LargeValueSource> m_src;
+	LargeValueReader *m_prev;
+};
+
+// the container of compressed project files.  format 2 starts with the
+// offset of the main stream, followed by the large values written out of
+// line while the main stream was produced, then the zlib main stream.
+// older files hold just the zlib stream (format 1) or are uncompressed
+class LargeValueArchive
+{
+public:
+	virtual ~LargeValueArchive() { }
+
+	bool WriteArchive( const wxString &file );
+	bool ReadArchive( const wxString &file );
+
+protected:
+	virtual void WriteMain( wxOutputStream &os ) = 0;
+	virtual bool ReadMain( wxInputStream &is ) = 0;
 };
 
 #define VF_NONE                0x00
@@ -289,10 +441,26 @@ private:
 
 };
 
-class VarTableScriptInterpreter : public lk::eval
+// reads and writes the ${name} values of a table for lk scripts,
+// whether they run on the tree walking interpreter or on the vm
+class VarTableSpecials
 {
+public:
+	VarTableSpecials( VarTable *vt ) : m_vars( vt ) { }
+
+	bool Set( const lk_string &name, lk::vardata_t &val );
+	bool Get( const lk_string &name, lk::vardata_t &val );
+	VarTable *Table() { return m_vars; }
+
 private:
 	VarTable *m_vars;
+};
+
+class VarTableScriptInterpreter : public lk::eval
+{
+private:
+	VarTableSpecials m_specials;
+
 public:
 	VarTableScriptInterpreter( lk::node_t *tree, lk::env_t *env, VarTable *vt );
 	virtual ~VarTableScriptInterpreter( );
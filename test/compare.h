@@ -0,0 +1,57 @@
+#ifndef __compare_h
+#define __compare_h
+
+#include <variables.h>
+
+// exact comparison, looking into tables and data arrays which
+// VarValue::Identical only treats as equal when they share storage
+inline bool identical_values(VarValue &a, VarValue &b)
+{
+    if (a.Type() != b.Type())
+        return false;
+
+    switch (a.Type())
+    {
+    case VV_TABLE:
+    {
+        if (a.Table().size() != b.Table().size())
+            return false;
+        for (VarTable::iterator it = a.Table().begin(); it != a.Table().end(); ++it)
+        {
+            VarValue *vv = b.Table().Get(it->first);
+            if (!vv || !identical_values(*it->second, *vv))
+                return false;
+        }
+        return true;
+    }
+    case VV_DATARR:
+    {
+        std::vector<VarValue> &x = a.DataArray(), &y = b.DataArray();
+        if (x.size() != y.size())
+            return false;
+        for (size_t i = 0; i < x.size(); i++)
+            if (!identical_values(x[i], y[i]))
+                return false;
+        return true;
+    }
+    case VV_DATMAT:
+    {
+        std::vector<std::vector<VarValue>> &x = a.DataMatrix(), &y = b.DataMatrix();
+        if (x.size() != y.size())
+            return false;
+        for (size_t i = 0; i < x.size(); i++)
+        {
+            if (x[i].size() != y[i].size())
+                return false;
+            for (size_t j = 0; j < x[i].size(); j++)
+                if (!identical_values(x[i][j], y[i][j]))
+                    return false;
+        }
+        return true;
+    }
+    default:
+        return a.Identical(b);
+    }
+}
+
+#endif
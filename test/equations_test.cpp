@@ -0,0 +1,452 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <vector>
+
+#include <wx/dir.h>
+#include <wx/ffile.h>
+#include <wx/filename.h>
+#include <wx/init.h>
+#include <wx/stopwatch.h>
+
+#include <lk/stdlib.h>
+
+#include <equations.h>
+#include "compare.h"
+
+// equations loaded one script per database, so that each one's index in
+// the lookup follows the order the scripts are added
+class EqnSet
+{
+public:
+    ~EqnSet()
+    {
+        for (size_t i = 0; i < m_dbs.size(); i++)
+            delete m_dbs[i];
+    }
+
+    bool Add(const wxString &script)
+    {
+        EqnDatabase *db = new EqnDatabase;
+        m_dbs.push_back(db);
+        if (!db->LoadScript(script))
+            return false;
+        m_efl.AddDatabase(db);
+        m_efl.Add(db->GetEquations());
+        return true;
+    }
+
+    int Index(const wxString &var) { return m_efl.GetEquationIndex(var); }
+    EqnFastLookup &Lookup() { return m_efl; }
+
+private:
+    std::vector<EqnDatabase*> m_dbs;
+    EqnFastLookup m_efl;
+};
+
+static bool contains(const wxArrayString &list, const wxString &text)
+{
+    for (size_t i = 0; i < list.size(); i++)
+        if (list[i].Contains(text))
+            return true;
+    return false;
+}
+
+TEST(Equations, PlanOrder)
+{
+    EqnSet eqns;
+    ASSERT_TRUE(eqns.Add("equations{'c'} = define() { return ${b} + 1; };"));
+    ASSERT_TRUE(eqns.Add("equations{'b'} = define() { return ${a} * 2; };"));
+    ASSERT_TRUE(eqns.Add("equations{'e'} = define() { return ${k}; };"));
+
+    int c = eqns.Index("c"), b = eqns.Index("b"), e = eqns.Index("e");
+    ASSERT_EQ(c, 0);
+    ASSERT_EQ(b, 1);
+    ASSERT_EQ(e, 2);
+
+    // b and e are ready at the start.  once b is done, c is ready too and
+    // comes before e, having the lower index
+    const EqnFastLookup::Plan &plan = eqns.Lookup().GetPlan();
+    ASSERT_EQ(plan.order.size(), 3u);
+    EXPECT_EQ(plan.order[0], b);
+    EXPECT_EQ(plan.order[1], c);
+    EXPECT_EQ(plan.order[2], e);
+    EXPECT_TRUE(plan.cyclic.empty());
+
+    ASSERT_EQ(plan.levels.size(), 2u);
+    EXPECT_EQ(plan.levels[0], std::vector<int>({ b, e }));
+    EXPECT_EQ(plan.levels[1], std::vector<int>({ c }));
+
+    VarTable vars;
+    vars.Set("a", VarValue(3.0));
+    vars.Set("k", VarValue(5.0));
+    vars.Set("b", VarValue(0.0));
+    vars.Set("c", VarValue(0.0));
+    vars.Set("e", VarValue(0.0));
+
+    EqnEvaluator ev(vars, eqns.Lookup());
+    EXPECT_EQ(ev.CalculateAll(), 3);
+    EXPECT_TRUE(ev.GetErrors().empty());
+    EXPECT_EQ(vars.Get("b")->Value(), 6);
+    EXPECT_EQ(vars.Get("c")->Value(), 7);
+    EXPECT_EQ(vars.Get("e")->Value(), 5);
+}
+
+TEST(Equations, PlanCycle)
+{
+    EqnSet eqns;
+    ASSERT_TRUE(eqns.Add("equations{'p'} = define() { return ${q} + 1; };"));
+    ASSERT_TRUE(eqns.Add("equations{'q'} = define() { return ${p} + 1; };"));
+    ASSERT_TRUE(eqns.Add("equations{'r'} = define() { return ${p}; };"));
+    ASSERT_TRUE(eqns.Add("equations{'s'} = define() { return ${k}; };"));
+
+    // everything on or downstream of the cycle is left out of the order
+    const EqnFastLookup::Plan &plan = eqns.Lookup().GetPlan();
+    EXPECT_EQ(plan.order, std::vector<int>({ eqns.Index("s") }));
+    EXPECT_EQ(plan.cyclic, std::vector<int>({ eqns.Index("p"), eqns.Index("q"), eqns.Index("r") }));
+
+    VarTable vars;
+    vars.Set("k", VarValue(2.0));
+    vars.Set("p", VarValue(0.0));
+    vars.Set("q", VarValue(0.0));
+    vars.Set("r", VarValue(0.0));
+    vars.Set("s", VarValue(0.0));
+
+    EqnEvaluator ev(vars, eqns.Lookup());
+    EXPECT_EQ(ev.CalculateAll(), -1);
+    EXPECT_EQ(vars.Get("s")->Value(), 2);
+
+    wxArrayString &errors = ev.GetErrors();
+    EXPECT_TRUE(contains(errors, "eqn not evaluated: [p]"));
+    EXPECT_TRUE(contains(errors, "eqn not evaluated: [q]"));
+    EXPECT_TRUE(contains(errors, "eqn not evaluated: [r]"));
+    EXPECT_FALSE(contains(errors, "eqn not evaluated: [s]"));
+}
+
+TEST(Equations, FailedInput)
+{
+    // the missing variable makes 'a_fail' fail, so 'b' is skipped, while
+    // 'c' doesn't depend on it and is still evaluated
+    EqnSet eqns;
+    ASSERT_TRUE(eqns.Add("equations{'a_fail'} = define() { return ${missing} + 1; };"));
+    ASSERT_TRUE(eqns.Add("equations{'b'} = define() { return ${a_fail} + 1; };"));
+    ASSERT_TRUE(eqns.Add("equations{'c'} = define() { return ${a} + 1; };"));
+
+    VarTable vars;
+    vars.Set("a", VarValue(1.0));
+    vars.Set("a_fail", VarValue(0.0));
+    vars.Set("b", VarValue(0.0));
+    vars.Set("c", VarValue(0.0));
+
+    EqnEvaluator ev(vars, eqns.Lookup());
+    EXPECT_EQ(ev.CalculateAll(), -1);
+    EXPECT_EQ(vars.Get("b")->Value(), 0);
+    EXPECT_EQ(vars.Get("c")->Value(), 2);
+
+    wxArrayString &errors = ev.GetErrors();
+    EXPECT_TRUE(contains(errors, "fail: [a_fail]"));
+    EXPECT_TRUE(contains(errors, "eqn not evaluated: [a_fail]"));
+    EXPECT_TRUE(contains(errors, "eqn not evaluated: [b]"));
+    EXPECT_FALSE(contains(errors, "fail: [b]"));
+    EXPECT_FALSE(contains(errors, "eqn not evaluated: [c]"));
+}
+
+TEST(Equations, CutoffUnchanged)
+{
+    // b only depends on the sign of a, so c is left alone
+    // until a change to a actually changes b
+    EqnSet eqns;
+    ASSERT_TRUE(eqns.Add("equations{'b'} = define() { if (${a} > 0) { return 1; } else { return 0; } };"));
+    ASSERT_TRUE(eqns.Add("equations{'c'} = define() { return ${b} + 100; };"));
+
+    VarTable vars;
+    vars.Set("a", VarValue(3.0));
+    vars.Set("b", VarValue(0.0));
+    vars.Set("c", VarValue(0.0));
+
+    EqnEvaluator ev(vars, eqns.Lookup());
+    ASSERT_EQ(ev.CalculateAll(), 2);
+    EXPECT_EQ(vars.Get("c")->Value(), 101);
+
+    wxArrayString trigger;
+    trigger.Add("a");
+
+    ev.GetUpdated().Clear();
+    vars.Set("a", VarValue(5.0));
+    EXPECT_EQ(ev.Changed(trigger), 1);
+    EXPECT_TRUE(contains(ev.GetUpdated(), "b"));
+    EXPECT_FALSE(contains(ev.GetUpdated(), "c"));
+    EXPECT_EQ(vars.Get("c")->Value(), 101);
+
+    ev.GetUpdated().Clear();
+    vars.Set("a", VarValue(-1.0));
+    EXPECT_EQ(ev.Changed(trigger), 2);
+    EXPECT_TRUE(contains(ev.GetUpdated(), "c"));
+    EXPECT_EQ(vars.Get("b")->Value(), 0);
+    EXPECT_EQ(vars.Get("c")->Value(), 100);
+    EXPECT_TRUE(ev.GetErrors().empty());
+}
+
+TEST(Equations, CutoffUnchangedMIMO)
+{
+    // the same with a multiple output equation: d reads both of its outputs
+    EqnSet eqns;
+    ASSERT_TRUE(eqns.Add("equations{'$MIMO$ m'} = define() { if (${a} > 0) { ${m1} = 1; } else { ${m1} = 0; } ${m2} = 2; };"));
+    ASSERT_TRUE(eqns.Add("equations{'d'} = define() { return ${m1} + ${m2}; };"));
+
+    VarTable vars;
+    vars.Set("a", VarValue(3.0));
+    vars.Set("m1", VarValue(0.0));
+    vars.Set("m2", VarValue(0.0));
+    vars.Set("d", VarValue(0.0));
+
+    EqnEvaluator ev(vars, eqns.Lookup());
+    ASSERT_EQ(ev.CalculateAll(), 2);
+    EXPECT_EQ(vars.Get("d")->Value(), 3);
+
+    wxArrayString trigger;
+    trigger.Add("a");
+
+    ev.GetUpdated().Clear();
+    vars.Set("a", VarValue(5.0));
+    EXPECT_EQ(ev.Changed(trigger), 1);
+    EXPECT_TRUE(contains(ev.GetUpdated(), "m1"));
+    EXPECT_FALSE(contains(ev.GetUpdated(), "d"));
+
+    ev.GetUpdated().Clear();
+    vars.Set("a", VarValue(-1.0));
+    EXPECT_EQ(ev.Changed(trigger), 2);
+    EXPECT_TRUE(contains(ev.GetUpdated(), "d"));
+    EXPECT_EQ(vars.Get("d")->Value(), 2);
+    EXPECT_TRUE(ev.GetErrors().empty());
+}
+
+// a wide database: many independent equations on each level, some of which
+// fail, so that levels are split into batches for the worker threads
+static void wide_equations(EqnSet &eqns, VarTable &vars, wxArrayString &outputs, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        wxString k = wxString::Format("%d", (int)i), k1 = wxString::Format("%d", (int)((i + 1) % n));
+        wxString input = (i % 7 == 3) ? "missing" + k : "in" + k;
+        eqns.Add("equations{'x" + k + "'} = define() { return sqrt(${" + input + "}) * " + k + "; };");
+        eqns.Add("equations{'y" + k + "'} = define() { return [ ${x" + k + "}, ${x" + k + "} + ${x" + k1 + "} ]; };");
+        eqns.Add("equations{'$MIMO$ z" + k + "'} = define() { if (${y" + k + "}[1] > 100) { ${z" + k + "} = 1; } else { ${z" + k + "} = 0; } ${w" + k + "} = #${y" + k + "}; };");
+
+        vars.Set("in" + k, VarValue((double)(i + 1)));
+        outputs.Add("x" + k);
+        outputs.Add("y" + k);
+        outputs.Add("z" + k);
+        outputs.Add("w" + k);
+    }
+
+    for (size_t i = 0; i < outputs.size(); i++)
+        vars.Set(outputs[i], VarValue(0.0));
+}
+
+static void expect_same(VarTable &serial, VarTable &threaded, const wxArrayString &outputs,
+    EqnEvaluator &ev1, EqnEvaluator &ev2)
+{
+    for (size_t i = 0; i < outputs.size(); i++)
+        EXPECT_TRUE(serial.Get(outputs[i])->Identical(*threaded.Get(outputs[i]))) << outputs[i];
+
+    // threads merge their errors level by level, so only the order may differ
+    wxArrayString e1 = ev1.GetErrors(), e2 = ev2.GetErrors();
+    e1.Sort();
+    e2.Sort();
+    EXPECT_TRUE(e1 == e2);
+    EXPECT_FALSE(e1.empty());
+}
+
+TEST(Equations, ThreadsMatchSerial)
+{
+    // the worker threads need wx's thread support initialized
+    wxInitializer init;
+    ASSERT_TRUE(init.IsOk());
+
+    const size_t n = 64;
+    EqnSet eqns;
+    VarTable serial, threaded;
+    wxArrayString outputs;
+    wide_equations(eqns, serial, outputs, n);
+    threaded = serial;
+
+    EqnEvaluator ev1(serial, eqns.Lookup());
+    EqnEvaluator ev2(threaded, eqns.Lookup());
+    ev1.SetThreads(1);
+    ev2.SetThreads(4);
+    ev2.SetMinBatch(2);
+
+    EXPECT_EQ(ev1.CalculateAll(), ev2.CalculateAll());
+    expect_same(serial, threaded, outputs, ev1, ev2);
+
+    // and again when only some inputs change
+    wxArrayString trigger;
+    for (size_t i = 0; i < n; i += 5)
+    {
+        wxString name = wxString::Format("in%d", (int)i);
+        trigger.Add(name);
+        serial.Set(name, VarValue(1000.0 + i));
+        threaded.Set(name, VarValue(1000.0 + i));
+    }
+
+    ev1.GetErrors().Clear();
+    ev2.GetErrors().Clear();
+    EXPECT_EQ(ev1.Changed(trigger), ev2.Changed(trigger));
+    expect_same(serial, threaded, outputs, ev1, ev2);
+
+    EqnEvaluator::StopThreads();
+}
+
+// the equation script of a shipped input page.  the page files end with the
+// equation and callback scripts, each written as its length in characters on
+// a line of its own followed by the text.  the form and variables before them
+// are skipped by looking for the last length that accounts for the rest of
+// the file exactly
+static bool page_equations(const wxString &file, wxString &script)
+{
+    wxFFile fp(file, "r");
+    wxString text;
+    if (!fp.IsOpened() || !fp.ReadAll(&text, wxConvUTF8))
+        return false;
+
+    bool found = false;
+    size_t len = text.Len();
+    for (size_t start = 0; start < len; )
+    {
+        size_t eol = text.find('\n', start);
+        if (eol == wxString::npos)
+            break;
+
+        unsigned long n = 0, m = 0;
+        wxString line = text.Mid(start, eol - start);
+        size_t next = eol + 1;
+        if (!line.IsEmpty() && line.IsNumber() && line.ToULong(&n))
+        {
+            // an empty script is followed directly by the next length
+            size_t end = n > 0 ? eol + 1 + n : eol;
+            if (end < len && text[end] == '\n')
+            {
+                size_t eol2 = text.find('\n', end + 1);
+                wxString line2 = text.Mid(end + 1, eol2 == wxString::npos ? wxString::npos : eol2 - end - 1);
+                if (!line2.IsEmpty() && line2.IsNumber() && line2.ToULong(&m)
+                    && (m > 0 ? eol2 != wxString::npos && len - (eol2 + 1) == m
+                        : text.Mid(end + 1 + line2.Len()).Trim().IsEmpty()))
+                {
+                    script = n > 0 ? text.Mid(eol + 1, n) : wxString();
+                    found = true;
+                }
+            }
+        }
+        start = next;
+    }
+
+    return found;
+}
+
+// the standard functions without the ones that open windows
+class TestEvaluator : public EqnEvaluator
+{
+public:
+    TestEvaluator(VarTable &vars, EqnFastLookup &efl) : EqnEvaluator(vars, efl) { }
+
+    virtual void SetupEnvironment(lk::env_t &env)
+    {
+        env.register_funcs(lk::stdlib_basic());
+        env.register_funcs(lk::stdlib_sysio());
+        env.register_funcs(lk::stdlib_math());
+        env.register_funcs(lk::stdlib_string());
+    }
+};
+
+// which equations failed, leaving out the engine's own messages, since the vm
+// and the interpreter may word the same failure differently
+static wxArrayString failures(const wxArrayString &errors)
+{
+    wxArrayString list;
+    for (size_t i = 0; i < errors.size(); i++)
+        if (errors[i].StartsWith("fail: ") || errors[i].StartsWith("eqn not evaluated: ")
+            || errors[i].StartsWith("no variables calculated"))
+            list.Add(errors[i]);
+    return list;
+}
+
+// runs the equations of the shipped input pages over each configuration's
+// defaults, compiled on the vm and on the interpreter, and expects the same
+// outputs and failures.  a configuration gets the pages whose outputs are all
+// among its defaults, and only the standard lk functions are available, so
+// equations calling sam functions fail the same way on both
+TEST(Equations, CompiledMatchesInterpreted)
+{
+    wxString runtime = wxFileName(__FILE__).GetPath() + "/../deploy/runtime";
+    wxArrayString pages, defaults;
+    if (wxDir::Exists(runtime + "/ui"))
+        wxDir::GetAllFiles(runtime + "/ui", &pages, "*.txt", wxDIR_FILES);
+    if (wxDir::Exists(runtime + "/defaults"))
+        wxDir::GetAllFiles(runtime + "/defaults", &defaults, "*.txt", wxDIR_FILES);
+    if (pages.size() == 0 || defaults.size() == 0)
+        GTEST_SKIP() << "runtime folder not found: " << runtime.ToStdString();
+
+    std::vector<EqnDatabase*> dbs;
+    for (size_t i = 0; i < pages.size(); i++)
+    {
+        wxString script;
+        ASSERT_TRUE(page_equations(pages[i], script)) << pages[i];
+        if (script.IsEmpty())
+            continue;
+
+        EqnDatabase *db = new EqnDatabase;
+        EXPECT_TRUE(db->LoadScript(script)) << pages[i];
+        dbs.push_back(db);
+    }
+
+    long vm_ms = 0, interp_ms = 0;
+    size_t neqns = 0;
+    for (size_t i = 0; i < defaults.size(); i++)
+    {
+        VarTable base;
+        ASSERT_TRUE(base.Read_text(defaults[i])) << defaults[i];
+
+        EqnFastLookup efl;
+        for (size_t k = 0; k < dbs.size(); k++)
+        {
+            const std::vector<EqnData*> &list = dbs[k]->GetEquations();
+            bool all = list.size() > 0;
+            for (size_t j = 0; all && j < list.size(); j++)
+                for (size_t m = 0; all && m < list[j]->outputs.size(); m++)
+                    all = base.Get(list[j]->outputs[m]) != 0;
+
+            if (all)
+            {
+                efl.AddDatabase(dbs[k]);
+                efl.Add(list);
+            }
+        }
+        neqns += efl.GetEquations().size();
+
+        VarTable compiled(base), interpreted(base);
+        TestEvaluator ev1(compiled, efl), ev2(interpreted, efl);
+        ev2.SetCompiled(false);
+
+        wxStopWatch sw;
+        int n1 = ev1.CalculateAll();
+        vm_ms += sw.Time();
+        sw.Start();
+        int n2 = ev2.CalculateAll();
+        interp_ms += sw.Time();
+
+        EXPECT_EQ(n1, n2) << defaults[i];
+        EXPECT_TRUE(failures(ev1.GetErrors()) == failures(ev2.GetErrors())) << defaults[i];
+        for (VarTable::iterator it = compiled.begin(); it != compiled.end(); ++it)
+        {
+            VarValue *vv = interpreted.Get(it->first);
+            ASSERT_TRUE(vv != 0) << it->first;
+            EXPECT_TRUE(identical_values(*it->second, *vv)) << defaults[i] << ": " << it->first;
+        }
+    }
+
+    for (size_t i = 0; i < dbs.size(); i++)
+        delete dbs[i];
+
+    printf("%d configurations, %d equations: vm %ld ms, interpreter %ld ms\n",
+        (int)defaults.size(), (int)neqns, vm_ms, interp_ms);
+}
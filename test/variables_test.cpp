@@ -1,8 +1,19 @@
 #include <gtest/gtest.h>
 #include <string>
+#include <cmath>
+
+#include <wx/dir.h>
+#include <wx/filename.h>
+#include <wx/mstream.h>
+#include <wx/stopwatch.h>
+#include <wx/wfstream.h>
 
 #include <variables.h>
+#include "compare.h"
 #include <lk/env.h>
+#include <lk/parse.h>
+#include <lk/eval.h>
+#include <lk/stdlib.h>
 
 
 TEST(VarTable_variables, Invalid)
@@ -95,6 +106,38 @@ TEST(VarTable_variables, Array)
     ssc_var_free(var);
 }
 
+TEST(VarTable_variables, ArrayEncodings)
+{
+    // long series round trip through each numeric encoding
+    std::vector<double> smooth(8760), steps(8760), noise(8760);
+    for (size_t i = 0; i < smooth.size(); i++){
+        smooth[i] = 20 + 10 * sin(i * 0.01);
+        steps[i] = (double)(i / 100);
+        noise[i] = (double)((i * 2654435761u) % 1000) / 7.0;
+    }
+    std::vector<double> *series[3] = {&smooth, &steps, &noise};
+    for (int k = 0; k < 6; k++){
+        VarValue vv(*series[k % 3]);
+        wxMemoryOutputStream out;
+        if (k < 3) {
+            // the encoded layout is only written where it is enabled
+            NumericEncodingScope encode;
+            vv.Write(out);
+        }
+        else
+            vv.Write(out);
+        const unsigned char *head = (const unsigned char *)out.GetOutputStreamBuffer()->GetBufferStart();
+        EXPECT_EQ(head[1], k < 3 ? 4 : 3);
+        wxMemoryInputStream in(out);
+        VarValue back;
+        ASSERT_TRUE(back.Read(in));
+        size_t n = 0;
+        const double *p = back.Array(&n);
+        ASSERT_EQ(n, series[k % 3]->size());
+        EXPECT_EQ(memcmp(p, &(*series[k % 3])[0], n * sizeof(double)), 0);
+    }
+}
+
 TEST(VarTable_variables, Matrix)
 {
     // ssc data into sam data
@@ -223,6 +266,117 @@ TEST(VarTable_variables, DataMatrix)
 }
 
 
+TEST(VarTable_variables, LayeredBase)
+{
+    std::shared_ptr<VarTable> base = std::make_shared<VarTable>();
+    base->Set("a", VarValue(1.0));
+    base->Set("b", VarValue(2.0));
+
+    VarTable layer;
+    layer.SetBase(base);
+    layer.Set("b", VarValue(3.0));
+    EXPECT_EQ(layer.Get("a")->Value(), 1);
+    EXPECT_EQ(layer.Get("b")->Value(), 3);
+    EXPECT_EQ(layer.size(), 1);
+
+    // writes copy the value out of the base and leave the base untouched
+    layer.GetWritable("a")->Set(4.0);
+    EXPECT_EQ(layer.Get("a")->Value(), 4);
+    EXPECT_EQ(base->Get("a")->Value(), 1);
+    EXPECT_EQ(base->Get("b")->Value(), 2);
+
+    base->Set("c", VarValue(5.0));
+    layer.Flatten();
+    EXPECT_EQ(layer.GetBase(), nullptr);
+    EXPECT_EQ(layer.size(), 3);
+    EXPECT_EQ(layer.Get("c")->Value(), 5);
+}
+
+TEST(VarTable_variables, ValueStorage)
+{
+    // short and long strings survive copies
+    VarValue s1(wxString("inline"));
+    VarValue s2(wxString("a string that is too long to be stored inline"));
+    VarValue c1 = s1, c2 = s2;
+    EXPECT_EQ(c1.String(), "inline");
+    EXPECT_EQ(c2.String(), s2.String());
+
+    // a number keeps its value when changed to an array
+    VarValue num(3.5);
+    num.SetType(VV_ARRAY);
+    EXPECT_EQ(num.Length(), 1);
+    EXPECT_EQ(num.Value(), 3.5);
+
+    // a value can be assigned from inside its own table
+    VarValue tab;
+    tab.Table().Set("x", VarValue(2.0));
+    tab = *tab.Table().Get("x");
+    EXPECT_EQ(tab.Type(), VV_NUMBER);
+    EXPECT_EQ(tab.Value(), 2);
+
+    // the accessor of another type leaves the value alone
+    VarValue kept(4.0);
+    EXPECT_EQ(kept.Table().size(), 0);
+    EXPECT_EQ(kept.Binary().GetDataLen(), 0);
+    EXPECT_EQ(kept.Type(), VV_NUMBER);
+    EXPECT_EQ(kept.Value(), 4);
+
+    VarValue moved(std::move(c2));
+    EXPECT_EQ(moved.String(), s2.String());
+    EXPECT_EQ(c2.Type(), VV_INVALID);
+
+    // copies share an array until one of them is written to
+    double arr[3] = {1, 2, 3};
+    VarValue a1(arr, 3);
+    VarValue a2 = a1;
+    EXPECT_TRUE(a2.SharesData(a1));
+    size_t n = 0;
+    const double *q = a2.Array(&n);
+    ASSERT_EQ(n, 3);
+    EXPECT_EQ(q[0], 1);
+    EXPECT_TRUE(a2.SharesData(a1));
+    double *p = a2.WritableArray(&n);
+    ASSERT_EQ(n, 3);
+    EXPECT_FALSE(a2.SharesData(a1));
+    p[0] = 10;
+    EXPECT_EQ(a1.Array()[0], 1);
+    EXPECT_EQ(a2.Array()[0], 10);
+
+    // identical values compare bit for bit, not within a tolerance
+    VarValue a3(arr, 3);
+    EXPECT_TRUE(a3.Identical(a1));
+    EXPECT_FALSE(a3.Identical(a2));
+    VarValue x1(1.0), x2(1.0 + 1e-12);
+    EXPECT_TRUE(x1.ValueEqual(x2));
+    EXPECT_FALSE(x1.Identical(x2));
+    EXPECT_FALSE(x1.Identical(s1));
+}
+
+TEST(VarTable_variables, ScriptArrays)
+{
+    // a script changing an array it read in place leaves the table value
+    // and later reads of it unchanged
+    double arr[2] = {1, 2};
+    VarTable vt;
+    vt.Set("x", VarValue(arr, 2));
+    vt.Set("n", VarValue(0.0));
+
+    lk::input_string in("append(${x}, 3); a = ${x}; ${n} = #a;");
+    lk::parser parse(in);
+    lk::node_t *tree = parse.script();
+    ASSERT_TRUE(tree != 0);
+    ASSERT_EQ(parse.error_count(), 0);
+
+    lk::env_t env;
+    env.register_funcs(lk::stdlib_basic());
+    VarTableScriptInterpreter e(tree, &env, &vt);
+    EXPECT_TRUE(e.run());
+    delete tree;
+
+    EXPECT_EQ(vt.Get("n")->Value(), 2);
+    EXPECT_EQ(vt.Get("x")->Length(), 2);
+}
+
 TEST(LK_SSC_invoke, Invalid)
 {
     // ssc data into lk data
@@ -465,3 +619,182 @@ TEST(LK_SSC_invoke, DataMatrix)
     ssc_var_free(var);
     ssc_var_free(data_matt);
 }
+
+static wxString defaults_folder(wxArrayString &files)
+{
+    wxString dir = wxFileName(__FILE__).GetPath() + "/../deploy/runtime/defaults";
+    if (wxDir::Exists(dir))
+        wxDir::GetAllFiles(dir, &files, "*.txt", wxDIR_FILES);
+    return dir;
+}
+
+// compares the mapped text reader with the stream reader over the shipped
+// defaults.  both must produce exactly the same values, bit for bit
+TEST(VarTable_variables, ReadTextDefaults)
+{
+    wxArrayString files;
+    wxString dir = defaults_folder(files);
+    if (files.size() == 0)
+        GTEST_SKIP() << "defaults folder not found: " << dir.ToStdString();
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        VarTable by_stream;
+        wxFFileInputStream in(files[i]);
+        ASSERT_TRUE(by_stream.Read_text(in));
+
+        VarTable by_map;
+        ASSERT_TRUE(by_map.Read_text(files[i]));
+
+        ASSERT_EQ(by_map.size(), by_stream.size()) << files[i];
+        for (VarTable::iterator it = by_stream.begin(); it != by_stream.end(); ++it)
+        {
+            VarValue *vv = by_map.Get(it->first);
+            ASSERT_TRUE(vv != 0) << it->first;
+            EXPECT_TRUE(identical_values(*vv, *it->second)) << files[i] << ": " << it->first;
+        }
+    }
+}
+
+// times both text readers over the shipped defaults.  not run by default:
+// use --gtest_also_run_disabled_tests --gtest_filter=*ReadTextDefaultsBenchmark
+TEST(VarTable_variables, DISABLED_ReadTextDefaultsBenchmark)
+{
+    wxArrayString files;
+    wxString dir = defaults_folder(files);
+    if (files.size() == 0)
+        GTEST_SKIP() << "defaults folder not found: " << dir.ToStdString();
+
+    const int passes = 5;
+    long stream_ms = 0, map_ms = 0;
+    for (int k = 0; k < passes; k++)
+    {
+        wxStopWatch sw;
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            VarTable tab;
+            wxFFileInputStream in(files[i]);
+            ASSERT_TRUE(tab.Read_text(in));
+        }
+        stream_ms += sw.Time();
+
+        sw.Start();
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            VarTable tab;
+            ASSERT_TRUE(tab.Read_text(files[i]));
+        }
+        map_ms += sw.Time();
+    }
+
+    printf("%d files, averaged over %d passes: stream reader %.1f ms, mapped reader %.1f ms\n",
+        (int)files.size(), passes, stream_ms / (double)passes, map_ms / (double)passes);
+}
+
+TEST(VarTable_variables, LargeValues)
+{
+    // a large array written out of line is only loaded once it is used
+    std::vector<double> series(8760);
+    for (size_t i = 0; i < series.size(); i++)
+        series[i] = 100 * sin(i * 0.01);
+
+    wxString blobs = wxFileName::CreateTempFileName("samlv");
+    wxMemoryOutputStream main;
+    {
+        wxFFileOutputStream out(blobs);
+        ASSERT_TRUE(out.IsOk());
+        LargeValueWriter large(out);
+        VarValue(series).Write(main);
+        VarValue(2.5).Write(main);
+    }
+
+    {
+        std::shared_ptr<LargeValueSource> src(new LargeValueSource);
+        ASSERT_TRUE(src->Open(blobs));
+        EXPECT_TRUE(LargeValueSource::InUse(blobs));
+
+        VarValue arr, num;
+        {
+            wxMemoryInputStream in(main);
+            LargeValueReader reader(src);
+            ASSERT_TRUE(arr.Read(in));
+            ASSERT_TRUE(num.Read(in));
+        }
+        EXPECT_EQ(num.Value(), 2.5);
+        EXPECT_EQ(arr.Length(), series.size());
+
+        // copies share the pending payload and see the same data
+        VarValue copy = arr;
+        LargeValueSource::Detach(blobs);
+        size_t n = 0;
+        const double *p = copy.Array(&n);
+        ASSERT_EQ(n, series.size());
+        EXPECT_EQ(memcmp(p, &series[0], n * sizeof(double)), 0);
+        EXPECT_EQ(arr.Array()[100], series[100]);
+    }
+
+    EXPECT_FALSE(LargeValueSource::InUse(blobs));
+    wxRemoveFile(blobs);
+}
+
+// a table written as the main stream of a project style archive
+class TableArchive : public LargeValueArchive
+{
+public:
+    VarTable table;
+protected:
+    virtual void WriteMain(wxOutputStream &os) { table.Write(os); }
+    virtual bool ReadMain(wxInputStream &is) { return table.Read(is); }
+};
+
+TEST(VarTable_variables, LargeValueArchive)
+{
+    std::vector<double> series(8760);
+    for (size_t i = 0; i < series.size(); i++)
+        series[i] = 100 * sin(i * 0.01);
+
+    TableArchive saved;
+    saved.table.Set("series", VarValue(series));
+    saved.table.Set("number", VarValue(2.5));
+    saved.table.Set("name", VarValue(wxString("archive")));
+
+    wxString file = wxFileName::CreateTempFileName("samar");
+    ASSERT_TRUE(saved.WriteArchive(file));
+
+    {
+        // the main stream is found through the offset written after it
+        TableArchive loaded;
+        ASSERT_TRUE(loaded.ReadArchive(file));
+        ASSERT_EQ(loaded.table.size(), saved.table.size());
+        EXPECT_TRUE(LargeValueSource::InUse(file));
+
+        // saving over the file while values are still pending in it
+        // writes beside it and renames the new file into place
+        saved.table.Set("number", VarValue(3.5));
+        ASSERT_TRUE(saved.WriteArchive(file));
+        EXPECT_FALSE(wxFileExists(file + ".tmp"));
+
+        for (VarTable::iterator it = saved.table.begin(); it != saved.table.end(); ++it)
+        {
+            VarValue *vv = loaded.table.Get(it->first);
+            ASSERT_TRUE(vv != 0) << it->first;
+            if (it->first != "number")
+                EXPECT_TRUE(vv->Identical(*it->second)) << it->first;
+        }
+        EXPECT_EQ(loaded.table.Get("number")->Value(), 2.5);
+    }
+    EXPECT_FALSE(LargeValueSource::InUse(file));
+
+    {
+        // the reader's own reference is gone once ReadArchive returns, so
+        // loading the value drops the last reference to the source
+        TableArchive loaded;
+        ASSERT_TRUE(loaded.ReadArchive(file));
+        EXPECT_EQ(loaded.table.Get("number")->Value(), 3.5);
+        EXPECT_TRUE(LargeValueSource::InUse(file));
+        EXPECT_TRUE(loaded.table.Get("series")->Identical(*saved.table.Get("series")));
+        EXPECT_FALSE(LargeValueSource::InUse(file));
+    }
+
+    wxRemoveFile(file);
+}